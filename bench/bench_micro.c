@@ -0,0 +1,193 @@
+// Micro-benchmark dei componenti in utils/: loader, ring buffer_t,
+// thread pool e kernel di pagerank(). Ogni risultato è una riga JSON su
+// stdout, così run_bench.sh può raccoglierli senza parsing ad hoc.
+#include "../utils/graph.h"
+#include "../utils/loader.h"
+#include "../utils/nodebuffer.h"
+#include "../utils/pagerank.h"
+#include "../utils/stats.h"
+#include "../utils/threadpool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void report(const char *name, int threads, long items, double secs) {
+  fprintf(stdout,
+          "{\"bench\": \"%s\", \"threads\": %d, \"items\": %ld, "
+          "\"seconds\": %.9f, \"items_per_sec\": %.1f}\n",
+          name, threads, items, secs, secs > 0 ? items / secs : 0);
+  fflush(stdout);
+}
+
+// Carica il grafo da file, archi inseriti al secondo
+// Il loader non termina il processo: un file non valido ferma qui il bench
+static grafo *load_or_die(char *filename, int threads, stats_t *stats) {
+  grafo *g = load_graph(filename, threads, stats);
+  if (g == NULL) {
+    perror("Errore caricamento grafo");
+    exit(EXIT_FAILURE);
+  }
+  return g;
+}
+
+static void bench_loader(char *filename, int threads, int reps) {
+  stats_t stats;
+  double best = 0;
+  long edges = 0;
+
+  for (int r = 0; r < reps; r++) {
+    stats_init(&stats, true);
+    double start = stats_now();
+    grafo *g = load_or_die(filename, threads, &stats);
+    double secs = stats_now() - start;
+    edges = stats.edges_read;
+    free_grafo(g);
+    stats_destroy(&stats);
+    if (r == 0 || secs < best)
+      best = secs;
+  }
+
+  report("loader", threads, edges, best);
+}
+
+static void *ring_consumer(void *arg) {
+  buffer_t *buf = (buffer_t *)arg;
+  // buffer_consume termina il thread quando riceve la tupla (-1, -1)
+  while (1)
+    buffer_consume(buf);
+  return NULL;
+}
+
+// Un produttore e threads consumer sul ring buffer, tuple al secondo
+static void bench_ring(int threads, long items, int reps) {
+  double best = 0;
+
+  for (int r = 0; r < reps; r++) {
+    buffer_t buf;
+    buffer_init(&buf, 2048);
+    pthread_t *cons = (pthread_t *)calloc(threads, sizeof(pthread_t));
+
+    double start = stats_now();
+    for (int i = 0; i < threads; i++)
+      pthread_create(&cons[i], NULL, ring_consumer, &buf);
+
+    for (long i = 0; i < items; i++) {
+      tupla t = {.IN = (int)(i & 0xffff), .OUT = (int)(i >> 16)};
+      buffer_produce(&buf, t);
+    }
+    for (int i = 0; i < threads; i++) {
+      tupla t = {.IN = -1, .OUT = -1};
+      buffer_produce(&buf, t);
+    }
+    for (int i = 0; i < threads; i++)
+      pthread_join(cons[i], NULL);
+    double secs = stats_now() - start;
+
+    free(cons);
+    buffer_destroy(&buf);
+    if (r == 0 || secs < best)
+      best = secs;
+  }
+
+  report("ring_buffer", threads, items, best);
+}
+
+static void empty_job(void *arg) { (void)arg; }
+
+// Lavori vuoti: misura solo il costo di tp_add_work + esecuzione + tp_wait
+static void bench_threadpool(int threads, long jobs, int reps) {
+  double best = 0;
+  double best_create = 0;
+
+  for (int r = 0; r < reps; r++) {
+    double start = stats_now();
+    thread_pool_t *tpool = tp_create(threads);
+    double created = stats_now();
+
+    for (long i = 0; i < jobs; i++)
+      tp_add_work(tpool, empty_job, NULL);
+    tp_wait(tpool);
+    double secs = stats_now() - created;
+
+    tp_destroy(tpool);
+    if (r == 0 || secs < best)
+      best = secs;
+    if (r == 0 || created - start < best_create)
+      best_create = created - start;
+  }
+
+  report("threadpool_jobs", threads, jobs, best);
+  report("threadpool_create", threads, 1, best_create);
+}
+
+// Iterazioni a numero fisso (eps = 0), archi elaborati al secondo
+static void bench_kernel(char *filename, int threads, int iters, int reps) {
+  grafo *g = load_or_die(filename, threads, NULL);
+  long edges = grafo_arcs(g);
+
+  double best = 0;
+  for (int r = 0; r < reps; r++) {
+    stats_t stats;
+    stats_init(&stats, true);
+    int num = 0;
+    double *p = pagerank(g, 0.9, 0, iters, threads, &num, &stats);
+
+    double secs = 0;
+    for (int i = 0; i < stats.iters_num; i++)
+      secs += stats.iters[i].time;
+
+    free(p);
+    stats_destroy(&stats);
+    if (r == 0 || secs < best)
+      best = secs;
+  }
+
+  report("rank_kernel", threads, edges * iters, best);
+  free_grafo(g);
+}
+
+int main(int argc, char *argv[]) {
+  int threads = 3;
+  int reps = 3;
+  long items = 1000000;
+  int iters = 10;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:r:n:i:")) != -1) {
+    switch (opt) {
+    case 't':
+      threads = atoi(optarg);
+      break;
+    case 'r':
+      reps = atoi(optarg);
+      break;
+    case 'n':
+      items = atol(optarg);
+      break;
+    case 'i':
+      iters = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-t T] [-r REPS] [-n ITEMS] [-i ITERS] graph\n",
+              argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (optind >= argc || threads <= 0 || reps <= 0 || items <= 0 ||
+      iters <= 0) {
+    fprintf(stderr, "Usage: %s [-t T] [-r REPS] [-n ITEMS] [-i ITERS] graph\n",
+            argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  char *filename = argv[optind];
+
+  bench_ring(threads, items, reps);
+  bench_threadpool(threads, items, reps);
+  bench_loader(filename, threads, reps);
+  bench_kernel(filename, threads, iters, reps);
+
+  return 0;
+}
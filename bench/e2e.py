@@ -0,0 +1,116 @@
+#! /usr/bin/env python3
+
+import argparse, contextlib, io, json, os, subprocess, sys, time
+
+Description = """
+Suite end-to-end: genera grafi sintetici con gen_graph, esegue ./pagerank
+con --stats json e registra tempi e memoria per fase in formato JSON lines.
+Sui grafi piu' piccoli confronta il risultato con pagerank.py.
+"""
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+from pagerank import pagerank as reference_pagerank  # noqa: E402
+
+MODELS = ["rmat", "er", "powerlaw"]
+
+
+def generate(model, nodes, edges, seed, datadir):
+    path = os.path.join(datadir, f"{model}_{nodes}_{edges}_{seed}.mtx")
+    if not os.path.exists(path):
+        subprocess.run([os.path.join(ROOT, "bench", "gen_graph"), "-g", model,
+                        "-n", str(nodes), "-m", str(edges), "-s", str(seed),
+                        "-o", path], check=True)
+    return path
+
+
+def run_pagerank(path, threads, k):
+    start = time.monotonic()
+    res = subprocess.run([os.path.join(ROOT, "pagerank"), "--stats", "json",
+                          "-t", str(threads), "-k", str(k), path],
+                         capture_output=True, text=True)
+    wall = time.monotonic() - start
+    if res.returncode != 0:
+        raise RuntimeError(f"pagerank failed on {path}: {res.stderr}")
+    return res.stdout, json.loads(res.stderr), wall
+
+
+def parse_top(stdout):
+    top = []
+    lines = stdout.splitlines()
+    for i, line in enumerate(lines):
+        if line.startswith("Top "):
+            for entry in lines[i + 1:]:
+                node, value = entry.split()
+                top.append((int(node), value))
+    return top
+
+
+def check_reference(path, nodes, stdout, k):
+    graph = []
+    with open(path) as f:
+        header = False
+        for line in f:
+            if line[0] == '%':
+                continue
+            if not header:
+                header = True
+                continue
+            tail, head = map(int, line.split())
+            graph.append((tail - 1, head - 1))
+    # pagerank.py conta 1+max(id): un self-loop sull'ultimo nodo (ignorato
+    # da entrambe le implementazioni) allinea il numero di nodi all'header
+    graph.append((nodes - 1, nodes - 1))
+    with contextlib.redirect_stdout(io.StringIO()):
+        ranks, _, _ = reference_pagerank(graph, epsilon=1.0e-7)
+    ours = parse_top(stdout)
+    for node, value in ours:
+        if f"{ranks[node]:.6f}" != value:
+            return False
+    expected = sorted(ranks, reverse=True)[:k]
+    return [f"{v:.6f}" for v in expected] == [v for _, v in ours]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=Description, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('-s', '--scales', help='numero di archi per grafo (default 1000,10000,100000)',
+                        type=str, default="1000,10000,100000")
+    parser.add_argument('-t', '--threads', help='thread per pagerank (default 3)', type=int, default=3)
+    parser.add_argument('-k', help='top K nodi confrontati (default 10)', type=int, default=10)
+    parser.add_argument('--check-max', help='archi massimi per il confronto con pagerank.py (default 100000)',
+                        type=int, default=100000)
+    parser.add_argument('--datadir', help='cartella dei grafi generati', type=str,
+                        default=os.path.join(ROOT, "bench", "data"))
+    parser.add_argument('-o', '--output', help='file JSON lines dei risultati', type=str,
+                        default=os.path.join(ROOT, "bench", "results.jsonl"))
+    args = parser.parse_args()
+
+    os.makedirs(args.datadir, exist_ok=True)
+    failures = 0
+    with open(args.output, "a") as out:
+        for edges in map(int, args.scales.split(",")):
+            nodes = max(edges // 8, 16)
+            for model in MODELS:
+                path = generate(model, nodes, edges, 1, args.datadir)
+                stdout, stats, wall = run_pagerank(path, args.threads, args.k)
+                record = {"model": model, "nodes": nodes, "edges": edges,
+                          "threads": args.threads, "wall": wall,
+                          "phases": stats["phases"],
+                          "load_edges_per_sec": stats["load_edges_per_sec"],
+                          "iterations": stats["iterations"],
+                          "peak_rss_kb": stats["peak_rss_kb"],
+                          "thread_pool": stats["thread_pool"]}
+                if edges <= args.check_max:
+                    record["reference_match"] = check_reference(path, nodes, stdout, args.k)
+                    failures += not record["reference_match"]
+                out.write(json.dumps(record) + "\n")
+                print(f"{model:>8} {edges:>10} edges  pagerank {stats['phases']['pagerank']:.4f}s"
+                      f"  rss {stats['peak_rss_kb']} KB"
+                      f"  ref {record.get('reference_match', 'skipped')}")
+    if failures:
+        print(f"{failures} graph(s) differ from pagerank.py")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,255 @@
+// Generatore deterministico di grafi sintetici in formato MatrixMarket o
+// nello stream binario PRGB letto da utils/loader.c.
+// Modelli: R-MAT/Kronecker, Erdős–Rényi G(n, m) e power-law (Chung-Lu).
+// A parità di parametri e seed l'output è identico bit per bit.
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// splitmix64: veloce, con stato a 64 bit e riproducibile su ogni piattaforma
+static uint64_t rng_state;
+
+static uint64_t rng_next(void) {
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Reale uniforme in [0, 1)
+static double rng_double(void) { return (rng_next() >> 11) * 0x1.0p-53; }
+
+// Intero uniforme in [0, n)
+static long rng_below(long n) { return (long)(rng_double() * n); }
+
+static bool binary_output = false;
+
+static void put_le32(FILE *f, uint32_t v) {
+  unsigned char b[4] = {v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24};
+  fwrite(b, 1, 4, f);
+}
+
+// Arco con id 1-based
+static void emit_edge(FILE *f, long src, long dst) {
+  if (binary_output) {
+    put_le32(f, (uint32_t)src);
+    put_le32(f, (uint32_t)dst);
+  } else {
+    fprintf(f, "%ld %ld\n", src, dst);
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s -g rmat|er|powerlaw -n N -m M [-s SEED] [-o outfile]\n"
+          "          [-f mtx|bin]       formato di output (default mtx)\n"
+          "          [-a A -b B -c C]   probabilita' R-MAT (default 0.57 "
+          "0.19 0.19)\n"
+          "          [-x EXP]           esponente power-law (default 2.1)\n",
+          prog);
+  exit(EXIT_FAILURE);
+}
+
+// R-MAT: ad ogni livello sceglie uno dei quattro quadranti della matrice di
+// adiacenza con probabilità a, b, c, d. Gli archi fuori da [0, n) vengono
+// rigenerati, così n non deve essere una potenza di 2.
+static void gen_rmat(FILE *f, long n, long m, double a, double b, double c) {
+  int levels = 0;
+  while ((1L << levels) < n)
+    levels++;
+
+  for (long e = 0; e < m;) {
+    long src = 0, dst = 0;
+    for (int l = 0; l < levels; l++) {
+      double r = rng_double();
+      src <<= 1;
+      dst <<= 1;
+      if (r < a) {
+      } else if (r < a + b) {
+        dst |= 1;
+      } else if (r < a + b + c) {
+        src |= 1;
+      } else {
+        src |= 1;
+        dst |= 1;
+      }
+    }
+    if (src >= n || dst >= n)
+      continue;
+    emit_edge(f, src + 1, dst + 1);
+    e++;
+  }
+}
+
+// Erdős–Rényi G(n, m): m archi con estremi uniformi
+static void gen_er(FILE *f, long n, long m) {
+  for (long e = 0; e < m; e++) {
+    long src = rng_below(n);
+    long dst = rng_below(n);
+    emit_edge(f, src + 1, dst + 1);
+  }
+}
+
+// Estrae un indice dalla distribuzione cumulativa con ricerca binaria
+static long sample_cdf(const double *cdf, long n) {
+  double r = rng_double() * cdf[n - 1];
+  long lo = 0, hi = n - 1;
+  while (lo < hi) {
+    long mid = lo + (hi - lo) / 2;
+    if (cdf[mid] <= r)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Chung-Lu: il nodo i ha peso (i+1)^(-1/(exp-1)), sorgenti e destinazioni
+// sono estratte in proporzione al peso. Le destinazioni passano per una
+// permutazione casuale, così gli hub in ingresso e in uscita sono diversi.
+static void gen_powerlaw(FILE *f, long n, long m, double exp) {
+  double *cdf = (double *)malloc(n * sizeof(double));
+  long *perm = (long *)malloc(n * sizeof(long));
+  if (cdf == NULL || perm == NULL) {
+    perror("Errore allocazione generatore power-law.");
+    exit(EXIT_FAILURE);
+  }
+
+  double alpha = 1.0 / (exp - 1.0);
+  double acc = 0;
+  for (long i = 0; i < n; i++) {
+    acc += pow((double)(i + 1), -alpha);
+    cdf[i] = acc;
+    perm[i] = i;
+  }
+
+  // Fisher-Yates
+  for (long i = n - 1; i > 0; i--) {
+    long j = rng_below(i + 1);
+    long t = perm[i];
+    perm[i] = perm[j];
+    perm[j] = t;
+  }
+
+  for (long e = 0; e < m; e++) {
+    long src = sample_cdf(cdf, n);
+    long dst = perm[sample_cdf(cdf, n)];
+    emit_edge(f, src + 1, dst + 1);
+  }
+
+  free(cdf);
+  free(perm);
+}
+
+int main(int argc, char *argv[]) {
+  char *model = NULL;
+  char *outfile = NULL;
+  long n = 0, m = 0;
+  uint64_t seed = 1;
+  double a = 0.57, b = 0.19, c = 0.19;
+  double exp = 2.1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "g:n:m:s:o:a:b:c:x:f:")) != -1) {
+    switch (opt) {
+    case 'g':
+      model = optarg;
+      break;
+    case 'n':
+      n = atol(optarg);
+      break;
+    case 'm':
+      m = atol(optarg);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'o':
+      outfile = optarg;
+      break;
+    case 'a':
+      a = atof(optarg);
+      break;
+    case 'b':
+      b = atof(optarg);
+      break;
+    case 'c':
+      c = atof(optarg);
+      break;
+    case 'x':
+      exp = atof(optarg);
+      break;
+    case 'f':
+      if (strcmp(optarg, "bin") == 0)
+        binary_output = true;
+      else if (strcmp(optarg, "mtx") != 0)
+        usage(argv[0]);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (model == NULL || n <= 0 || m <= 0)
+    usage(argv[0]);
+  if (a < 0 || b < 0 || c < 0 || a + b + c > 1) {
+    fprintf(stderr, "Invalid R-MAT probabilities.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (exp <= 1) {
+    fprintf(stderr, "Invalid power-law exponent.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  FILE *f = stdout;
+  if (outfile != NULL) {
+    f = fopen(outfile, binary_output ? "wb" : "w");
+    if (f == NULL) {
+      perror("Errore apertura file di output.");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Buffer grande: l'output è dominato da molte fprintf brevi
+  static char iobuf[1 << 20];
+  setvbuf(f, iobuf, _IOFBF, sizeof(iobuf));
+
+  rng_state = seed;
+
+  if (binary_output) {
+    // Intestazione PRGB, vedi utils/loader.h
+    fwrite("PRGB", 1, 4, f);
+    put_le32(f, 1);
+    put_le32(f, (uint32_t)n);
+    put_le32(f, 0);
+    put_le32(f, (uint32_t)m);
+    put_le32(f, (uint32_t)((uint64_t)m >> 32));
+  } else {
+    fprintf(f, "%%%%MatrixMarket matrix coordinate pattern general\n");
+    fprintf(f, "%% gen_graph -g %s -n %ld -m %ld -s %llu\n", model, n, m,
+            (unsigned long long)seed);
+    fprintf(f, "%ld %ld %ld\n", n, n, m);
+  }
+
+  if (strcmp(model, "rmat") == 0) {
+    gen_rmat(f, n, m, a, b, c);
+  } else if (strcmp(model, "er") == 0) {
+    gen_er(f, n, m);
+  } else if (strcmp(model, "powerlaw") == 0) {
+    gen_powerlaw(f, n, m, exp);
+  } else {
+    fprintf(stderr, "Unknown model: %s\n", model);
+    exit(EXIT_FAILURE);
+  }
+
+  if (f != stdout)
+    fclose(f);
+  else
+    fflush(f);
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+#! /usr/bin/env python3
+
+import argparse, json, os, subprocess, time
+
+Description = """
+Latenza sui grafi piccoli: esegue ./pagerank piu' volte su grafi R-MAT da
+10 a 100000 archi e registra minimo, mediana e 95-esimo percentile del tempo
+end-to-end (processo compreso) e del totale interno di --stats json.
+"""
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def generate(nodes, edges, seed, datadir):
+    path = os.path.join(datadir, f"rmat_{nodes}_{edges}_{seed}.mtx")
+    if not os.path.exists(path):
+        subprocess.run([os.path.join(ROOT, "bench", "gen_graph"), "-g", "rmat",
+                        "-n", str(nodes), "-m", str(edges), "-s", str(seed),
+                        "-o", path], check=True)
+    return path
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p * len(values)))]
+
+
+def measure(path, threads, runs):
+    wall, total = [], []
+    for _ in range(runs):
+        start = time.perf_counter()
+        res = subprocess.run([os.path.join(ROOT, "pagerank"), "--stats", "json",
+                              "-t", str(threads), path],
+                             capture_output=True, text=True)
+        wall.append(time.perf_counter() - start)
+        if res.returncode != 0:
+            raise RuntimeError(f"pagerank failed on {path}: {res.stderr}")
+        total.append(json.loads(res.stderr)["phases"]["total"])
+    return wall, total
+
+
+def main():
+    parser = argparse.ArgumentParser(description=Description, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('-s', '--scales', help='numero di archi per grafo (default 10,100,1000,10000,100000)',
+                        type=str, default="10,100,1000,10000,100000")
+    parser.add_argument('-t', '--threads', help='thread per pagerank (default 3)', type=int, default=3)
+    parser.add_argument('-r', '--runs', help='esecuzioni per grafo (default 50)', type=int, default=50)
+    parser.add_argument('--datadir', help='cartella dei grafi generati', type=str,
+                        default=os.path.join(ROOT, "bench", "data"))
+    parser.add_argument('-o', '--output', help='file JSON lines dei risultati', type=str,
+                        default=os.path.join(ROOT, "bench", "results.jsonl"))
+    args = parser.parse_args()
+
+    os.makedirs(args.datadir, exist_ok=True)
+    with open(args.output, "a") as out:
+        for edges in map(int, args.scales.split(",")):
+            nodes = max(edges // 8, 16)
+            path = generate(nodes, edges, 1, args.datadir)
+            wall, total = measure(path, args.threads, args.runs)
+            record = {"bench": "latency", "model": "rmat", "nodes": nodes,
+                      "edges": edges, "threads": args.threads, "runs": args.runs,
+                      "wall_min": min(wall), "wall_p50": percentile(wall, 0.5),
+                      "wall_p95": percentile(wall, 0.95),
+                      "total_min": min(total), "total_p50": percentile(total, 0.5),
+                      "total_p95": percentile(total, 0.95)}
+            out.write(json.dumps(record) + "\n")
+            print(f"{edges:>10} edges  wall p50 {record['wall_p50'] * 1000:.3f} ms"
+                  f"  p95 {record['wall_p95'] * 1000:.3f} ms"
+                  f"  in-process p50 {record['total_p50'] * 1000:.3f} ms")
+
+
+if __name__ == '__main__':
+    main()
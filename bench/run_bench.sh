@@ -0,0 +1,30 @@
+#!/bin/sh
+# Benchmark completo: micro-benchmark dei componenti e suite end-to-end.
+# Variabili d'ambiente:
+#   BENCH_THREADS  thread usati da pagerank e dai micro-benchmark (default 3)
+#   BENCH_SCALES   archi dei grafi end-to-end, separati da virgola
+#   BENCH_MICRO_M  archi del grafo R-MAT dei micro-benchmark (default 131072)
+#   BENCH_RUNS     esecuzioni per grafo della misura di latenza (default 50)
+set -e
+cd "$(dirname "$0")/.."
+
+THREADS=${BENCH_THREADS:-3}
+SCALES=${BENCH_SCALES:-1000,10000,100000}
+MICRO_M=${BENCH_MICRO_M:-131072}
+RUNS=${BENCH_RUNS:-50}
+MICRO_N=$((MICRO_M / 8))
+MICRO_GRAPH=bench/data/micro_${MICRO_N}_${MICRO_M}.mtx
+
+mkdir -p bench/data
+if [ ! -f "$MICRO_GRAPH" ]; then
+  ./bench/gen_graph -g rmat -n "$MICRO_N" -m "$MICRO_M" -s 1 -o "$MICRO_GRAPH"
+fi
+
+echo "== micro-benchmark ($MICRO_GRAPH, $THREADS thread)"
+./bench/bench_micro -t "$THREADS" "$MICRO_GRAPH" | tee -a bench/results.jsonl
+
+echo "== end-to-end"
+python3 bench/e2e.py -s "$SCALES" -t "$THREADS"
+
+echo "== latenza sui grafi piccoli"
+python3 bench/latency.py -t "$THREADS" -r "$RUNS"
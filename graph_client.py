@@ -1,7 +1,11 @@
+import argparse
 import socket
-import threading
+import struct
 import sys
+import threading
 import logging
+import zlib
+from array import array
 
 # Configurazione del logging
 logging.basicConfig(filename='client.log', level=logging.INFO,
@@ -10,56 +14,143 @@ logging.basicConfig(filename='client.log', level=logging.INFO,
 # Numero di matricola
 port = 54348
 
-
-def handle_file(filename):
+# Protocollo v2 (vedi server.c): intestazione, archi in frame da al più
+# FRAME_MAX byte, risposta a sezioni
+V2_MAGIC = 0xFF325250
+FRAME_MAX = 1 << 20
+FLAG_RANKS = 1
+SEC_END, SEC_REPORT, SEC_TOP, SEC_RANKS = 0, 1, 2, 3
+
+
+def read_edges(filename):
+    with open(filename, 'r') as file:
+        lines = file.readlines()
+
+    # Saltare le linee di commento
+    data_lines = [line for line in lines if not line.startswith('%')]
+
+    # Leggere il numero di nodi e archi
+    n, m, a = map(int, data_lines[0].split())
+
+    # Archi come coppie consecutive di interi a 32 bit
+    edges = array('I')
+    for edge in data_lines[1:]:
+        parts = edge.split()
+        if len(parts) == 2:
+            edges.extend(map(int, parts))
+        else:
+            logging.warning(f"Invalid edge in file {filename}: {edge}")
+    if sys.byteorder != 'little':
+        edges.byteswap()
+    return n, a, edges
+
+
+def recv_exact(s, size):
+    buf = bytearray()
+    while len(buf) < size:
+        chunk = s.recv(min(size - len(buf), 1 << 20))
+        if not chunk:
+            raise ConnectionError("connection closed by server")
+        buf += chunk
+    return bytes(buf)
+
+
+def send_v1(s, n, a, edges):
+    # Gli archi letti vanno tutti insieme, come prima uno per uno
+    s.sendall(struct.pack('<II', n, a))
+    s.sendall(edges.tobytes())
+
+    # La risposta è il codice seguito dal testo fino alla chiusura
+    exit_code = struct.unpack('<I', recv_exact(s, 4))[0]
+    chunks = []
+    while True:
+        chunk = s.recv(1 << 16)
+        if not chunk:
+            break
+        chunks.append(chunk)
+    return exit_code, b''.join(chunks).decode(), None, None
+
+
+def send_v2(s, n, a, edges, k, compress, ranks):
+    flags = FLAG_RANKS if ranks else 0
+    s.sendall(struct.pack('<IIIII', V2_MAGIC, n, a, k, flags))
+
+    data = memoryview(edges.tobytes())
+    for off in range(0, len(data), FRAME_MAX):
+        raw = data[off:off + FRAME_MAX]
+        if compress:
+            packed = zlib.compress(raw, 1)
+            s.sendall(struct.pack('<II', len(raw), len(packed)) + packed)
+        else:
+            s.sendall(struct.pack('<II', len(raw), 0))
+            s.sendall(raw)
+    s.sendall(struct.pack('<II', 0, 0))
+
+    magic, exit_code = struct.unpack('<II', recv_exact(s, 8))
+    if magic != V2_MAGIC:
+        raise ValueError("server does not speak protocol v2")
+
+    report, top, rank_vector = '', None, None
+    while True:
+        kind, size = struct.unpack('<IQ', recv_exact(s, 12))
+        if kind == SEC_END:
+            break
+        body = recv_exact(s, size)
+        if kind == SEC_REPORT:
+            report = body.decode()
+        elif kind == SEC_TOP:
+            count = struct.unpack_from('<I', body)[0]
+            top = [struct.unpack_from('<Id', body, 4 + 12 * i)
+                   for i in range(count)]
+        elif kind == SEC_RANKS:
+            rank_vector = body
+    return exit_code, report, top, rank_vector
+
+
+def handle_file(filename, args):
     try:
-        with open(filename, 'r') as file:
-            lines = file.readlines()
-
-            # Saltare le linee di commento
-            data_lines = [line for line in lines if not line.startswith('%')]
-
-            # Leggere il numero di nodi e archi
-            n, m, a = map(int, data_lines[0].split())
-            edges = data_lines[1:]
-
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect(('127.0.0.1', port))
-
-                # Inviare numero di nodi e archi
-                s.sendall(n.to_bytes(4, byteorder='little'))
-                s.sendall(a.to_bytes(4, byteorder='little'))
-
-                # Inviare gli archi
-                for edge in edges:
-                    parts = edge.split()
-                    if len(parts) == 2:
-                        orig, dest = map(int, parts)
-                        s.sendall(orig.to_bytes(4, byteorder='little'))
-                        s.sendall(dest.to_bytes(4, byteorder='little'))
-                    else:
-                        logging.warning(
-                            f"Invalid edge in file {filename}: {edge}")
-
-                # Ricevere la risposta dal server
-                exit_code = int.from_bytes(s.recv(4), byteorder='little')
-                response = s.recv(4096).decode()
-
-                # Stampare il risultato
-                print(f"{filename} Exit code: {exit_code}")
-                print(response)
-                print(f"{filename} Bye")
+        n, a, edges = read_edges(filename)
+
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+            s.connect(('127.0.0.1', port))
+            if args.v1:
+                exit_code, response, top, rank_vector = send_v1(s, n, a, edges)
+            else:
+                exit_code, response, top, rank_vector = send_v2(
+                    s, n, a, edges, args.k, args.compress, args.ranks)
+
+        # Stampare il risultato
+        print(f"{filename} Exit code: {exit_code}")
+        print(response)
+        if rank_vector is not None:
+            # Rank di tutti i nodi come double little-endian
+            with open(filename + '.ranks', 'wb') as out:
+                out.write(rank_vector)
+            print(f"{filename} Ranks written to {filename}.ranks")
+        print(f"{filename} Bye")
 
     except Exception as e:
         logging.error(f"Error handling file {filename}: {e}")
 
 
 if __name__ == "__main__":
-    files = sys.argv[1:]
+    parser = argparse.ArgumentParser(
+        description="Invia grafi MatrixMarket al server PageRank")
+    parser.add_argument('files', nargs='+', help='grafi da inviare')
+    parser.add_argument('-k', type=int, default=0,
+                        help='nodi nel top K (default quello del server)')
+    parser.add_argument('-z', '--compress', action='store_true',
+                        help='comprime i frame di archi con zlib')
+    parser.add_argument('-r', '--ranks', action='store_true',
+                        help='riceve tutti i rank in FILE.ranks')
+    parser.add_argument('--v1', action='store_true',
+                        help='usa il protocollo v1 (solo nodi, archi e '
+                             'coppie, risposta di solo testo)')
+    args = parser.parse_args()
 
     threads = []
-    for filename in files:
-        thread = threading.Thread(target=handle_file, args=(filename,))
+    for filename in args.files:
+        thread = threading.Thread(target=handle_file, args=(filename, args))
         thread.start()
         threads.append(thread)
 
@@ -1,10 +1,23 @@
 #include <assert.h>
 #include <errno.h>
 #define _GNU_SOURCE
+#include "utils/autotune.h"
+#include "utils/batch.h"
+#include "utils/compact.h"
+#include "utils/components.h"
 #include "utils/graph.h"
+#include "utils/graph_shm.h"
+#include "utils/loader.h"
+#include "utils/metrics.h"
+#include "utils/montecarlo.h"
+#include "utils/peel.h"
 #include "utils/nodebuffer.h"
 #include "utils/pagerank.h"
+#include "utils/partition.h"
+#include "utils/rankdump.h"
+#include "utils/stats.h"
 #include <bits/pthreadtypes.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <signal.h>
@@ -14,143 +27,25 @@
 #include <string.h>
 #include <unistd.h>
 
-typedef struct value_node {
-  double value;
-  int index;
-} value_node_t;
-
-int cmp(const void *a, const void *b) {
-  value_node_t *a1 = (value_node_t *)a;
-  value_node_t *a2 = (value_node_t *)b;
-  if (a1->value > a2->value)
-    return -1;
-  else if (a1->value < a2->value)
-    return 1;
-  else
-    return 0;
-}
-
-void read_from_grafo(char *filename, buffer_t *buf, int thread_num, inmap *map,
-                     pthread_t *aux_threads) {
-  FILE *file = fopen(filename, "r");
-  if (file == NULL) {
-    perror("Errore lettura file.");
-    exit(EXIT_FAILURE);
-  }
-
-  // Buffer per leggere
-  char *line = NULL;
-  size_t len = 0;
-  ssize_t read;
-  int start_reading_nodes = 0;
-
-  while ((read = getline(&line, &len, file)) != -1) {
-    if (!start_reading_nodes) {
-      if (line[0] == '%') {
-        continue;
-      } else {
-        start_reading_nodes = 1;
-        continue;
-      }
-    }
-
-    if (line[0] == '%') {
-      continue;
-    }
-
-    char *ptr;
-    int in = strtol(line, &ptr, 10) - 1;
-    int out = strtol(ptr, NULL, 10) - 1;
-
-    tupla t = {.IN = in, .OUT = out};
-    buffer_produce(buf, t);
-  }
-
-  for (int i = 0; i < thread_num; i++) {
-    tupla t = {.IN = -1, .OUT = -1};
-    buffer_produce(buf, t);
-  }
-
-  free(line);
-  fclose(file);
-}
-
-int read_size_from_file(const char *filename) {
-  FILE *file = fopen(filename, "r");
-  if (file == NULL) {
-    perror("Error opening file");
-    exit(EXIT_FAILURE);
-  }
-
-  char *line = NULL;
-  size_t len = 0;
-  ssize_t read;
-
-  while ((read = getline(&line, &len, file)) != -1) {
-    if (line[0] == '%') {
-      continue;
-    } else {
-      char *token = strtok(line, " ");
-      if (token != NULL) {
-        int size = atoi(token);
-        free(line);
-        fclose(file);
-        return size;
-      } else {
-        perror("Errore: Impossibile leggere la dimensione della mappa");
-        free(line);
-        fclose(file);
-        exit(EXIT_FAILURE);
-      }
-    }
-  }
-
-  free(line);
-  fclose(file);
-  perror("Errore: Dimensione della mappa non trovata");
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-k K] [-m M] [-d D] [-e E] [-t T | -t auto [--calibrate]] "
+          "[--grain G] [--balance nodes|arcs] [--stable N] "
+          "[--stats json] [-o ranks.bin [--order]] "
+          "[--metrics PATH] [--compact] [--peel | --components] "
+          "[--mc WALKS [--seed S]] "
+          "[-P procs [--transport shm|unix]] {infile | - | --stdin}\n"
+          "       %s [-k K] [-m M] [-d D] [-e E] [-t T] [--stable N] "
+          "[--stats json] [-o ranks.bin [--order]] --shm-attach NAME\n"
+          "       %s --shm-publish NAME {infile | - | --stdin}\n"
+          "       %s --shm-unlink NAME\n"
+          "       %s [-k K] [-m M] [-d D] [-e E] [-t T] [--grain G] "
+          "[--balance nodes|arcs] [--stable N] --batch {LIST | -}\n"
+          "       %s --metrics-read PATH\n",
+          prog, prog, prog, prog, prog, prog);
   exit(EXIT_FAILURE);
 }
 
-typedef struct {
-  buffer_t *buffer;
-  inmap *map;
-  outgoing_edges_t *out;
-} consumer_args_t;
-
-void *consumer(void *arg) {
-  // printf("Consumer\n");
-  consumer_args_t *args = (consumer_args_t *)arg;
-  buffer_t *buf = args->buffer;
-  inmap *map = args->map;
-  outgoing_edges_t *out = args->out;
-
-  while (1) {
-    tupla t = buffer_consume(buf);
-    // printf("Cons: %d %d \n", t.IN, t.OUT);
-    if (t.IN == -1 && t.OUT == -1) {
-      return (void *)0;
-    }
-
-    // printf("Consumer Inmap-> %d\n", map);
-    // printf("Inserted %d %d \n", t.IN, t.OUT);
-    insert_inmap(map, t.IN, t.OUT, out);
-  }
-}
-
-static int compare(const void *a, const void *b) {
-  if (*(double *)a < *(double *)b)
-    return 1;
-  else if (*(double *)a > *(double *)b)
-    return -1;
-  else
-    return 0;
-}
-
-// Funzione per ordinare un array di double
-void sort_double_array(double *array, int size) {
-  qsort(array, size, sizeof(double), compare);
-}
-
 int main(int argc, char *argv[]) {
 
   // Parte segnali
@@ -165,9 +60,61 @@ int main(int argc, char *argv[]) {
   double E = 1.0e-7;   // default per max error
   int T = 3;           // default per threads
   char *infile = NULL; // input file
+  bool json_stats = false;
+  bool from_stdin = false; // infile "-" o --stdin
+  int P = 1;               // processi del calcolo partizionato
+  char *transport = "shm"; // trasporto tra i processi
+  char *shm_publish = NULL; // segmento in cui pubblicare il grafo
+  char *shm_attach = NULL;  // segmento da cui leggere il grafo
+  char *shm_unlink = NULL;  // segmento da rimuovere
+  int stable = 0; // iterazioni con top K invariato per fermarsi, 0 = no
+  char *dump = NULL;       // file per il vettore completo dei rank
+  bool dump_order = false; // aggiunge al file l'ordine dei nodi
+  bool compact = false;    // grafo solo sugli id usati negli archi
+  long mc_walks = 0;       // cammini della stima Monte Carlo, 0 = iterazione
+  long mc_seed = 1;
+  bool peel = false; // itera solo sul nucleo dopo aver tolto alberi e catene
+  bool components = false; // risolve a parte ogni componente debole
+  bool auto_tune = false;   // -t auto: configurazione dalla forma del grafo
+  bool calibrate = false;   // con -t auto misura le prime iterazioni
+  int grain = 0;            // nodi per lavoro del pool, 0 = automatico
+  int balance = -1;         // variante del kernel, -1 = automatica
+  char *batch = NULL;       // lista dei grafi della modalità batch
+  char *metrics_path = NULL; // pagina delle metriche da pubblicare
+  char *metrics_show = NULL; // pagina delle metriche da stampare
+
+  static struct option long_options[] = {{"stats", required_argument, 0, 'S'},
+                                         {"stdin", no_argument, 0, 'I'},
+                                         {"transport", required_argument, 0,
+                                          'R'},
+                                         {"shm-publish", required_argument, 0,
+                                          'U'},
+                                         {"shm-attach", required_argument, 0,
+                                          'A'},
+                                         {"shm-unlink", required_argument, 0,
+                                          'X'},
+                                         {"stable", required_argument, 0,
+                                          'B'},
+                                         {"order", no_argument, 0, 'O'},
+                                         {"compact", no_argument, 0, 'C'},
+                                         {"mc", required_argument, 0, 'W'},
+                                         {"seed", required_argument, 0, 'Z'},
+                                         {"peel", no_argument, 0, 'L'},
+                                         {"components", no_argument, 0, 'G'},
+                                         {"calibrate", no_argument, 0, 'Y'},
+                                         {"grain", required_argument, 0, 'N'},
+                                         {"balance", required_argument, 0,
+                                          'V'},
+                                         {"batch", required_argument, 0, 'F'},
+                                         {"metrics", required_argument, 0,
+                                          'Q'},
+                                         {"metrics-read", required_argument,
+                                          0, 'J'},
+                                         {0, 0, 0, 0}};
 
   int opt;
-  while ((opt = getopt(argc, argv, "k:m:d:e:t:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "k:m:d:e:t:P:o:", long_options, NULL)) !=
+         -1) {
     switch (opt) {
     case 'k':
       K = atoi(optarg);
@@ -182,12 +129,99 @@ int main(int argc, char *argv[]) {
       E = atof(optarg);
       break;
     case 't':
-      T = atoi(optarg);
+      // Il loader usa tutti i core, il calcolo quelli scelti sul grafo
+      if (strcmp(optarg, "auto") == 0) {
+        auto_tune = true;
+        T = autotune_cores();
+      } else {
+        T = atoi(optarg);
+      }
+      break;
+    case 'S':
+      if (strcmp(optarg, "json") != 0) {
+        fprintf(stderr, "Unsupported stats format: %s (expected json)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      json_stats = true;
+      break;
+    case 'I':
+      from_stdin = true;
+      break;
+    case 'P':
+      P = atoi(optarg);
+      break;
+    case 'R':
+      transport = optarg;
+      break;
+    case 'U':
+      shm_publish = optarg;
+      break;
+    case 'A':
+      shm_attach = optarg;
+      break;
+    case 'X':
+      shm_unlink = optarg;
+      break;
+    case 'B':
+      stable = atoi(optarg);
+      break;
+    case 'o':
+      dump = optarg;
+      break;
+    case 'O':
+      dump_order = true;
+      break;
+    case 'C':
+      compact = true;
+      break;
+    case 'W':
+      mc_walks = atol(optarg);
+      if (mc_walks <= 0) {
+        errno = 1;
+        perror("Invalid mc value.");
+        exit(1);
+      }
+      break;
+    case 'Z':
+      mc_seed = atol(optarg);
+      break;
+    case 'L':
+      peel = true;
+      break;
+    case 'G':
+      components = true;
+      break;
+    case 'Y':
+      calibrate = true;
+      break;
+    case 'N':
+      grain = atoi(optarg);
+      if (grain <= 0) {
+        errno = 1;
+        perror("Invalid grain value.");
+        exit(1);
+      }
+      break;
+    case 'V':
+      if (strcmp(optarg, "nodes") != 0 && strcmp(optarg, "arcs") != 0) {
+        fprintf(stderr, "Unsupported balance: %s (expected nodes or arcs)\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      balance = strcmp(optarg, "arcs") == 0;
+      break;
+    case 'F':
+      batch = optarg;
+      break;
+    case 'Q':
+      metrics_path = optarg;
+      break;
+    case 'J':
+      metrics_show = optarg;
       break;
     default:
-      fprintf(stderr, "Usage: %s [-k K] [-m M] [-d D] [-e E] [-t T] infile\n",
-              argv[0]);
-      exit(EXIT_FAILURE);
+      usage(argv[0]);
     }
   }
 
@@ -211,97 +245,399 @@ int main(int argc, char *argv[]) {
     perror("Invalid T value.");
     exit(1);
   }
+  if (stable < 0) {
+    errno = 1;
+    perror("Invalid stable value.");
+    exit(1);
+  }
+  if (P <= 0 || P > 64) {
+    errno = 1;
+    perror("Invalid P value.");
+    exit(1);
+  }
+
+  if (shm_unlink != NULL) {
+    int attached;
+    if (graph_shm_unlink(shm_unlink, &attached) != 0) {
+      perror("Errore rimozione segmento");
+      exit(EXIT_FAILURE);
+    }
+    printf("Segment %s removed, %d processes still attached\n", shm_unlink,
+           attached);
+    return 0;
+  }
+
+  if (metrics_show != NULL) {
+    // Una lettura della pagina di un altro processo, in formato Prometheus
+    const metrics_page_t *m = metrics_attach(metrics_show);
+    if (m == NULL) {
+      perror("Errore lettura metriche");
+      exit(EXIT_FAILURE);
+    }
+    metrics_page_t snap;
+    metrics_read(m, &snap);
+    metrics_detach(m);
+    metrics_print_prometheus(stdout, &snap);
+    return 0;
+  }
+
+  if (batch != NULL) {
+    // Un record JSON per grafo su stdout, il riepilogo su stderr
+    if (optind < argc || from_stdin || json_stats || P > 1 ||
+        shm_attach != NULL || shm_publish != NULL || dump != NULL ||
+        compact || mc_walks > 0 || peel || components || calibrate ||
+        metrics_path != NULL) {
+      fprintf(stderr, "--batch takes the graphs from LIST and cannot be "
+                      "combined with other input, -P, shared memory, "
+                      "--compact, --peel, --components, --mc, --calibrate, "
+                      "--metrics, -o or --stats\n");
+      exit(EXIT_FAILURE);
+    }
+    FILE *list = strcmp(batch, "-") == 0 ? stdin : fopen(batch, "r");
+    if (list == NULL) {
+      perror("Errore lettura lista.");
+      exit(EXIT_FAILURE);
+    }
+    pagerank_params_t params = {.d = D,
+                                .eps = E,
+                                .maxiter = M,
+                                .grain = grain,
+                                .balance_arcs = balance > 0,
+                                .stable_k = stable > 0 ? K : 0,
+                                .stable_iters = stable};
+    batch_summary_t summary;
+    if (pagerank_batch(list, &params, T, K, stdout, &summary) != 0) {
+      perror("Errore modalità batch");
+      exit(EXIT_FAILURE);
+    }
+    if (list != stdin)
+      fclose(list);
+    fprintf(stderr,
+            "Batch: %d graphs, %d failed, load %.3fs, compute %.3fs, wall "
+            "%.3fs\n",
+            summary.graphs, summary.failed, summary.load, summary.compute,
+            summary.wall);
+    return 0;
+  }
 
   if (optind < argc) {
     infile = argv[optind];
-  } else {
+    from_stdin = from_stdin || strcmp(infile, "-") == 0;
+  } else if (!from_stdin && shm_attach == NULL) {
     fprintf(stderr, "Expected infile argument after options\n");
-    fprintf(stderr, "Usage: %s [-k K] [-m M] [-d D] [-e E] [-t T] infile\n",
-            argv[0]);
-    exit(EXIT_FAILURE);
+    usage(argv[0]);
   }
 
-  int size = read_size_from_file(infile);
-  buffer_t *cb = (buffer_t *)calloc(1, sizeof(buffer_t));
-  inmap *map = create_inmap(size);
-  outgoing_edges_t *out = create_outgoing_edges(size);
-  consumer_args_t *ca = (consumer_args_t *)calloc(1, sizeof(consumer_args_t));
-  ca->buffer = cb;
-  ca->map = map;
-  ca->out = out;
-  pthread_t *threads = (pthread_t *)calloc(T, sizeof(pthread_t));
-
-  buffer_init(cb, 2048);
-
-  for (int i = 0; i < T; i++) {
-    pthread_create(&threads[i], NULL, consumer, (void *)ca);
+  if (P > 1) {
+    // Ogni processo rilegge il file, quindi serve un file vero
+    if (from_stdin || json_stats || shm_attach != NULL ||
+        shm_publish != NULL || stable > 0 || dump != NULL || compact ||
+        mc_walks > 0 || peel || components || metrics_path != NULL) {
+      fprintf(stderr, "-P cannot be combined with stdin input, shared "
+                      "memory, --stable, --compact, --peel, --components, "
+                      "--mc, --metrics, -o or --stats\n");
+      exit(EXIT_FAILURE);
+    }
+    pagerank_params_t params = {.d = D, .eps = E, .maxiter = M, .grain = grain,
+                                .balance_arcs = balance > 0};
+    if (pagerank_partitioned(infile, transport, P, &params, K, stdout) != 0) {
+      perror("Partitioned run failed");
+      exit(EXIT_FAILURE);
+    }
+    return 0;
   }
 
-  read_from_grafo(infile, cb, T, map, threads);
+  if (mc_walks > 0 && stable > 0) {
+    fprintf(stderr, "--stable applies only to the power iteration, not to "
+                    "--mc\n");
+    exit(EXIT_FAILURE);
+  }
+  if (peel && (mc_walks > 0 || stable > 0)) {
+    fprintf(stderr, "--peel cannot be combined with --mc or --stable\n");
+    exit(EXIT_FAILURE);
+  }
+  if (calibrate && !auto_tune) {
+    fprintf(stderr, "--calibrate requires -t auto\n");
+    exit(EXIT_FAILURE);
+  }
+  // La classifica della pagina è negli id del grafo iterato: con queste
+  // opzioni non sarebbero quelli dell'input
+  if (metrics_path != NULL && (compact || peel || components ||
+                               mc_walks > 0 || shm_publish != NULL)) {
+    fprintf(stderr, "--metrics cannot be combined with --compact, --peel, "
+                    "--components, --mc or --shm-publish\n");
+    exit(EXIT_FAILURE);
+  }
 
-  for (int i = 0; i < T; i++) {
-    pthread_join(threads[i], NULL);
+  // Pubblicata prima del caricamento, così chi legge vede lo stato
+  metrics_page_t *metrics = NULL;
+  if (metrics_path != NULL) {
+    metrics = metrics_create(metrics_path, K);
+    if (metrics == NULL) {
+      perror("Errore creazione pagina metriche");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (components && (peel || mc_walks > 0 || stable > 0)) {
+    fprintf(stderr, "--components cannot be combined with --peel, --mc or "
+                    "--stable\n");
+    exit(EXIT_FAILURE);
+  }
+  if (compact && (shm_attach != NULL || shm_publish != NULL)) {
+    fprintf(stderr, "--compact cannot be combined with shared memory\n");
+    exit(EXIT_FAILURE);
   }
 
-  free(threads);
-  buffer_destroy(cb);
-  free(cb);
-  free(ca);
+  stats_t stats;
+  stats_init(&stats, json_stats);
+  stats.threads = T;
+
+  // Con --shm-attach il grafo resta nella memoria condivisa: solo i vettori
+  // dei rank vengono allocati da questo processo
+  graph_shm_t *shm = NULL;
+  compact_graph_t *cg = NULL;
+  grafo *g;
+  if (shm_attach != NULL) {
+    stats_begin(&stats, PHASE_BUILD);
+    shm = graph_shm_attach(shm_attach);
+    if (shm == NULL) {
+      perror("Errore collegamento segmento");
+      exit(EXIT_FAILURE);
+    }
+    g = &shm->g;
+    stats_end(&stats, PHASE_BUILD);
+  } else if (compact) {
+    FILE *file = from_stdin ? stdin : fopen(infile, "r");
+    if (file == NULL) {
+      perror("Errore lettura file.");
+      exit(EXIT_FAILURE);
+    }
+    cg = load_graph_compact(file, T, &stats);
+    if (!from_stdin)
+      fclose(file);
+    g = cg->g;
+  } else {
+    g = from_stdin ? load_graph_stream(stdin, T, &stats)
+                   : load_graph(infile, T, &stats);
+    if (g == NULL) {
+      perror("Errore caricamento grafo");
+      exit(EXIT_FAILURE);
+    }
+  }
 
-  grafo *g = (grafo *)calloc(1, sizeof(grafo));
-  g->N = size;
-  g->in = map;
-  g->out = out->outgoing_edges;
+  if (shm_publish != NULL) {
+    if (graph_shm_publish(g, shm_publish) != 0) {
+      perror("Errore pubblicazione segmento");
+      exit(EXIT_FAILURE);
+    }
+    printf("Published %s: %d nodes, %ld arcs\n", shm_publish, g->N,
+           grafo_arcs(g));
+    free_grafo(g);
+    stats_destroy(&stats);
+    return 0;
+  }
 
   int *num = (int *)calloc(1, sizeof(int));
 
-  double *p = pagerank(g, D, E, M, T, num);
-
-  value_node_t *vn = (value_node_t *)calloc(g->N, sizeof(value_node_t));
-
-  for (int i = 0; i < g->N; i++) {
-    vn[i].value = p[i];
-    vn[i].index = i;
+  stats_begin(&stats, PHASE_PAGERANK);
+  pagerank_params_t params = {.d = D,
+                              .eps = E,
+                              .maxiter = M,
+                              .grain = grain,
+                              .balance_arcs = balance > 0,
+                              .stable_k = stable > 0 ? K : 0,
+                              .stable_iters = stable,
+                              .isolated = cg != NULL ? compact_isolated(cg) : 0,
+                              .metrics = metrics};
+
+  // Grafo piccolo senza varianti: il calcolo gira sul thread chiamante, e la
+  // configurazione automatica non avrebbe nulla da scegliere
+  bool sequential = mc_walks == 0 && !peel && !components &&
+                    g->N + grafo_arcs(g) <= PAGERANK_SEQUENTIAL_WORK;
+
+  // Le opzioni date esplicitamente hanno la precedenza sulla scelta
+  autotune_t at;
+  if (auto_tune && !sequential) {
+    autotune_graph(g, T, &at);
+    if (balance >= 0)
+      at.balance_arcs = balance > 0;
+    if (calibrate && autotune_calibrate(g, &params, &at) != 0) {
+      perror("Errore calibrazione");
+      exit(EXIT_FAILURE);
+    }
+    if (grain > 0)
+      at.grain = grain;
+    T = at.threads;
+    params.grain = at.grain;
+    params.balance_arcs = at.balance_arcs;
+    stats.threads = T;
   }
 
-  // sort_double_array(p, size);
-  qsort(vn, g->N, sizeof(value_node_t), cmp);
-
-  int dead_end = 0;
-  double ranks_sum = 0;
-  int valid_edges = 0;
-  for (int i = 0; i < g->N; i++) {
-    if (g->out[i] == 0)
-      dead_end++;
-    ranks_sum += p[i];
-    valid_edges += g->in->edges_array[i]->edges_num;
+  // SIGUSR1 viene servito dalle iterazioni di pagerank_run: il thread dei
+  // segnali legge il primo nodo dalla pagina di --metrics o da una privata
+  metrics_page_t *own = NULL;
+  pthread_t signal_thread;
+  bool signals = mc_walks == 0 && !components;
+  if (signals && params.metrics == NULL) {
+    own = metrics_create(NULL, 1);
+    params.metrics = own;
   }
-
-  fprintf(stdout, "Number of nodes: %d\n", g->N);
-  fprintf(stdout, "Number of dead-end nodes: %d\n", dead_end);
-  fprintf(stdout, "Number of valid arcs: %d\n", valid_edges);
-  if (*num < M) {
-    fprintf(stdout, "Converged after %d iterations\n", *num);
+  signals = signals && params.metrics != NULL &&
+            pagerank_signals_start(params.metrics, &signal_thread) == 0;
+
+  double *p;
+  double *se = NULL; // Errore standard della stima Monte Carlo
+  montecarlo_result_t mc;
+  int peeled_up = 0, peeled_down = 0, core_nodes = 0;
+  int components_num = 0, largest = 0;
+  if (mc_walks > 0) {
+    montecarlo_params_t mp = {.d = D,
+                              .walks = mc_walks,
+                              .seed = (uint64_t)mc_seed,
+                              .isolated = params.isolated};
+    thread_pool_t *tpool = tp_create(T);
+    if (pagerank_montecarlo(g, &mp, tpool, &mc, &stats) != 0) {
+      perror("Errore stima Monte Carlo");
+      exit(EXIT_FAILURE);
+    }
+    tp_destroy(tpool);
+    p = mc.ranks;
+    se = mc.se;
+    stats.monte_carlo = true;
+  } else if (peel) {
+    // I rank del nucleo tornano sui nodi di g prima di compact_expand
+    peel_t *pl = peel_graph(g, params.isolated, D);
+    if (pl == NULL) {
+      perror("Errore riduzione grafo");
+      exit(EXIT_FAILURE);
+    }
+    params.reduced = &pl->reduced;
+    params.isolated = 0;
+    double *core = pagerank_with_params(pl->core, &params, T, num, &stats);
+    p = peel_expand(pl, core);
+    if (p == NULL) {
+      perror("Errore espansione rank");
+      exit(EXIT_FAILURE);
+    }
+    peeled_up = pl->upstream_num;
+    peeled_down = pl->downstream_num;
+    core_nodes = pl->core->N;
+    free(core);
+    peel_free(pl);
+  } else if (components) {
+    thread_pool_t *tpool = tp_create(T);
+    components_t *cc = components_find(g, tpool);
+    if (cc == NULL) {
+      perror("Errore ricerca componenti");
+      exit(EXIT_FAILURE);
+    }
+    p = pagerank_components(cc, &params, tpool, num, &stats);
+    if (p == NULL) {
+      perror("Errore calcolo per componenti");
+      exit(EXIT_FAILURE);
+    }
+    components_num = cc->num;
+    largest = cc->largest;
+    components_free(cc);
+    tp_destroy(tpool);
+  } else if (sequential) {
+    // Grafo piccolo: niente pool, SIGUSR1 resta servito
+    stats.threads = 1;
+    p = pagerank_with_params(g, &params, 0, num, &stats);
+  } else {
+    p = pagerank_with_params(g, &params, T, num, &stats);
+  }
+  if (signals)
+    pagerank_signals_stop(params.metrics, signal_thread);
+  metrics_close(own);
+
+  // Rank negli id originali, nodi isolati compresi
+  int N = g->N;
+  if (cg != NULL) {
+    double *full = compact_expand(cg, p);
+    free(p);
+    p = full;
+    if (se != NULL) {
+      full = compact_expand(cg, se);
+      free(se);
+      se = full;
+    }
+    N = cg->N;
+  }
+  stats_end(&stats, PHASE_PAGERANK);
+
+  stats_begin(&stats, PHASE_SORT);
+  int *top = (int *)calloc(K < N ? K : N, sizeof(int));
+  pagerank_top_k(p, N, K, top);
+  stats_end(&stats, PHASE_SORT);
+
+  stats_begin(&stats, PHASE_OUTPUT);
+  if (mc_walks > 0) {
+    int dead_end = N - g->N;
+    for (int i = 0; i < g->N; i++) {
+      if (g->out[i] == 0)
+        dead_end++;
+    }
+    montecarlo_report(stdout, N, dead_end, grafo_arcs(g), &mc, p, se, K, top);
+  } else if (cg != NULL) {
+    compact_report(stdout, cg, p, *num, M, stats.stable_stop, K, top);
   } else {
-    fprintf(stdout, "Did not converge after %d iterations\n", M);
+    pagerank_report(stdout, g, p, *num, M, stats.stable_stop, K, top);
+  }
+  if (stats.stable_stop)
+    printf("Top %d stable for %d iterations: stopped early, an estimated %d "
+           "iterations saved\n",
+           K, stable, stats.iters_saved);
+  if (peel)
+    printf("Peeled %d upstream and %d downstream nodes, iterated on a core of "
+           "%d nodes\n",
+           peeled_up, peeled_down, core_nodes);
+  if (auto_tune && sequential)
+    printf("Auto-tuning skipped: %d nodes and %ld arcs run sequentially on 1 "
+           "thread\n",
+           g->N, grafo_arcs(g));
+  else if (auto_tune)
+    autotune_report(stdout, g, &at);
+  if (components)
+    printf("Solved %d weakly connected components separately, largest %d "
+           "nodes\n",
+           components_num, largest);
+  fflush(stdout);
+
+  if (dump != NULL) {
+    thread_pool_t *tpool = tp_create(T);
+    if (rank_dump_write(dump, p, N, dump_order, tpool) != 0) {
+      perror("Errore scrittura rank");
+      exit(EXIT_FAILURE);
+    }
+    tp_destroy(tpool);
   }
-  fprintf(stdout, "Sum of ranks: %0.4f   (should be 1)\n", ranks_sum);
-  if (K > g->N)
-    exit(0);
-  fprintf(stdout, "Top %d nodes:\n", K);
-  for (int i = 0; i < K; i++) {
-    fprintf(stdout, "  %d %lf\n", vn[i].index, vn[i].value);
+  stats_end(&stats, PHASE_OUTPUT);
+
+  if (json_stats) {
+    stats.nodes = N;
+    stats.dead_end = N - g->N;
+    for (int i = 0; i < g->N; i++) {
+      if (g->out[i] == 0)
+        stats.dead_end++;
+    }
+    stats.valid_edges = grafo_arcs(g);
+    stats.converged = *num < M && !stats.stable_stop && !stats.monte_carlo;
+    stats_print_json(&stats, stderr);
   }
+  stats_destroy(&stats);
 
-  free_inmap(map);
-  free_outgoing_edges(out);
-  free(g);
+  if (shm != NULL)
+    graph_shm_detach(shm);
+  else if (cg != NULL)
+    compact_free(cg);
+  else
+    free_grafo(g);
   free(num);
   free(p);
-  free(vn);
-
-  sleep(1); // Toglie le segnalazione dei thread su valgrind
-            // Gli da il tempo al O.S. di killarli
+  free(se);
+  free(top);
+  metrics_close(metrics);
 
   return 0;
 }
@@ -0,0 +1,1020 @@
+// Server PageRank nativo: stesso protocollo di graph_client.py (numero di
+// nodi, numero di archi e poi le coppie di archi, tutti interi a 32 bit
+// little-endian) ma con un unico thread epoll che legge a blocchi e passa
+// gli archi direttamente al builder in memoria. Il calcolo avviene nel
+// processo, su un thread pool condiviso, senza file temporanei.
+// I risultati sono in cache per SHA-256 di grafo e parametri: un grafo
+// reinviato identico riceve subito la risposta già calcolata.
+// Il protocollo v2 (intestazione che inizia con V2_MAGIC) manda gli archi
+// in frame, anche compressi, e riceve una risposta a sezioni.
+// I calcoli passano da una coda limitata: al più -j alla volta, con i -t
+// core divisi tra quelli in corso e i grafi piccoli serviti per primi.
+#define _GNU_SOURCE
+#include "utils/cache.h"
+#include "utils/libpagerank.h"
+#include "utils/sha256.h"
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Numero di matricola
+#define DEFAULT_PORT 54348
+
+#define READ_BUF_SIZE (1 << 16)
+#define MAX_EVENTS 64
+
+// Archi per thread richiesto da un calcolo: sotto questa soglia un thread
+#define ARCS_PER_THREAD (1 << 18)
+
+// Attesa oltre la quale un grafo passa davanti ai più piccoli
+#define STARVE_SEC 10.0
+
+// PROTOCOLLO v2 (interi little-endian)
+// Richiesta: magic | nodi u32 | archi attesi u32 | k u32 (0 = -k del server)
+//   | flag u32, poi frame: byte decompressi u32 | byte compressi u32 (0 = non
+//   compresso, altrimenti zlib) | dati. I dati sono coppie di u32 1-based come
+//   in v1, al più V2_FRAME_MAX byte per frame; un frame vuoto chiude.
+// Risposta: magic | codice u32 | sezioni tipo u32 | lunghezza u64 | dati,
+//   chiuse dalla sezione V2_SEC_END.
+// Il magic letto come numero di nodi v1 supera INT32_MAX, che v1 rifiuta:
+// i due protocolli non si confondono
+#define V2_MAGIC 0xFF325250u // "PR2\xff"
+#define V2_HEADER_SIZE 20
+#define V2_FRAME_MAX (1 << 20)
+#define V2_COMP_MAX (V2_FRAME_MAX + V2_FRAME_MAX / 64 + 64)
+#define V2_FLAG_RANKS 1u // Aggiunge il vettore completo dei rank
+
+enum {
+  V2_SEC_END = 0,
+  V2_SEC_REPORT = 1, // Testo del report, come la risposta v1
+  V2_SEC_TOP = 2,    // u32 k, poi k volte nodo u32 (0-based) e rank f64
+  V2_SEC_RANKS = 3,  // Rank f64 di tutti i nodi
+};
+
+// LOGGING (stesso formato di logging.basicConfig in Python)
+
+static FILE *log_file;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void log_msg(const char *fmt, ...) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  struct tm tm;
+  localtime_r(&tv.tv_sec, &tm);
+  char ts[32];
+  strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+
+  pthread_mutex_lock(&log_mutex);
+  fprintf(log_file, "%s,%03ld ", ts, (long)(tv.tv_usec / 1000));
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(log_file, fmt, ap);
+  va_end(ap);
+  fputc('\n', log_file);
+  fflush(log_file);
+  pthread_mutex_unlock(&log_mutex);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// CONNESSIONI
+
+typedef enum { CONN_LISTEN, CONN_SIGNAL, CONN_CLIENT } conn_kind_t;
+
+typedef struct conn {
+  conn_kind_t kind;
+  int fd;
+  char addr[64];
+
+  unsigned char header[V2_HEADER_SIZE]; // v1: numero di nodi e di archi
+  int header_len;
+  int version;
+  uint32_t n;
+  uint32_t a; // v2: solo un suggerimento
+  uint32_t k; // v2
+  uint32_t flags;
+
+  unsigned char frame_header[8]; // v2: frame in ricezione
+  int frame_header_len;
+  uint32_t raw_len;
+  uint32_t comp_len;
+  unsigned char *frame;
+  uint32_t frame_got;
+
+  uint32_t received; // Archi ricevuti finora (validi e non)
+  long valid;
+  long invalid;
+  unsigned char partial[8]; // Arco spezzato tra due read
+  int partial_len;
+
+  pr_builder_t *builder;
+  sha256_t hash; // Hash incrementale dei byte ricevuti
+  unsigned char key[SHA256_DIGEST_SIZE];
+  double start;
+  bool admitted;    // Conta nel limite della coda (-q)
+  double queued_at; // Ingresso nella coda dei lavori
+  struct conn *next; // Coda dei lavori
+
+  // Risposta da inviare: intestazione (codice, in v2 preceduto dal magic) e
+  // corpo, posseduto dalla connessione
+  unsigned char out_head[8];
+  size_t out_head_len;
+  char *out_body;
+  size_t out_len;
+  size_t out_sent; // Byte già inviati, intestazione compresa
+} conn_t;
+
+typedef struct {
+  int K;
+  pr_params_t params;
+  int cores;     // Thread di calcolo in tutto (-t)
+  int max_jobs;  // Calcoli contemporanei (-j)
+  int max_queue; // Grafi ammessi in attesa, in ricezione o in coda (-q)
+} server_config_t;
+
+static server_config_t config;
+static cache_t *cache; // NULL se disattivata
+
+// Blocchi di archi già convertiti a 0-based, passati al builder insieme
+static int src_block[READ_BUF_SIZE / 8];
+static int dst_block[READ_BUF_SIZE / 8];
+
+static void conn_free(conn_t *c) {
+  if (c->fd >= 0)
+    close(c->fd);
+  pr_builder_free(c->builder);
+  free(c->frame);
+  free(c->out_body);
+  free(c);
+}
+
+// Sezione della risposta v2
+static void put_section(FILE *f, uint32_t type, const void *data,
+                        uint64_t len) {
+  uint32_t t = htole32(type);
+  uint64_t l = htole64(len);
+  fwrite(&t, 4, 1, f);
+  fwrite(&l, 8, 1, f);
+  if (len > 0)
+    fwrite(data, 1, len, f);
+}
+
+// Prepara la risposta prendendo possesso di body (malloc). v1: codice di
+// uscita (4 byte little-endian) seguito dal testo. v2: magic e codice
+// seguiti dalle sezioni già codificate in body
+static void set_response(conn_t *c, uint32_t code, char *body, size_t len) {
+  uint32_t le[2] = {htole32(V2_MAGIC), htole32(code)};
+  c->out_head_len = c->version == 2 ? 8 : 4;
+  memcpy(c->out_head, c->version == 2 ? (void *)le : (void *)&le[1],
+         c->out_head_len);
+  free(c->out_body);
+  c->out_body = body;
+  c->out_len = body != NULL ? len : 0;
+  c->out_sent = 0;
+}
+
+// Un messaggio di testo come risposta del protocollo della connessione
+static void set_text(conn_t *c, uint32_t code, const char *text, size_t len) {
+  char *body = NULL;
+  size_t body_len = 0;
+  FILE *f = open_memstream(&body, &body_len);
+  if (f != NULL) {
+    if (c->version == 2) {
+      put_section(f, V2_SEC_REPORT, text, len);
+      put_section(f, V2_SEC_END, NULL, 0);
+    } else {
+      fwrite(text, 1, len, f);
+    }
+    fclose(f);
+  }
+  set_response(c, code, body, body_len);
+}
+
+// Invia quanto possibile della risposta. Ritorna 1 se è tutta inviata, 0 se
+// il socket non bloccante è pieno, -1 in caso di errore
+static int send_some(conn_t *c, int flags) {
+  size_t total = c->out_head_len + c->out_len;
+  while (c->out_sent < total) {
+    const char *buf;
+    size_t len;
+    if (c->out_sent < c->out_head_len) {
+      buf = (const char *)c->out_head + c->out_sent;
+      len = c->out_head_len - c->out_sent;
+    } else {
+      buf = c->out_body + (c->out_sent - c->out_head_len);
+      len = total - c->out_sent;
+    }
+    ssize_t w = send(c->fd, buf, len, MSG_NOSIGNAL | flags);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+      log_msg("Error handling client: %s", strerror(errno));
+      return -1;
+    }
+    c->out_sent += w;
+  }
+  return 1;
+}
+
+// Dai runner: il socket torna bloccante, un client lento ferma solo il
+// proprio runner
+static void send_response_blocking(conn_t *c) {
+  int flags = fcntl(c->fd, F_GETFL, 0);
+  fcntl(c->fd, F_SETFL, flags & ~O_NONBLOCK);
+  send_some(c, 0);
+}
+
+// CODA DEI LAVORI: il thread epoll accoda i grafi completi in ordine di
+// numero di archi, i runner (-j) li calcolano prendendo i core liberi e
+// rispondono al client
+
+static conn_t *jobs_head;
+static bool jobs_stop;
+static int jobs_waiting; // Grafi ammessi e non ancora in calcolo
+static int jobs_queued;  // Di questi, quelli già in coda
+static int jobs_running;
+static int cores_free;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+// Ammissione all'arrivo dell'intestazione: oltre -q grafi in attesa il
+// client viene rifiutato subito, prima di ricevere gli archi
+static bool jobs_admit(conn_t *c) {
+  pthread_mutex_lock(&jobs_mutex);
+  bool ok = jobs_waiting < config.max_queue;
+  if (ok)
+    jobs_waiting++;
+  pthread_mutex_unlock(&jobs_mutex);
+  c->admitted = ok;
+  return ok;
+}
+
+// Il grafo esce dall'attesa senza calcolo (chiusura o cache)
+static void jobs_release(conn_t *c) {
+  if (!c->admitted)
+    return;
+  pthread_mutex_lock(&jobs_mutex);
+  jobs_waiting--;
+  pthread_mutex_unlock(&jobs_mutex);
+  c->admitted = false;
+}
+
+// Inserimento ordinato per archi validi, a parità in ordine di arrivo
+static void jobs_push(conn_t *c) {
+  pthread_mutex_lock(&jobs_mutex);
+  c->queued_at = now_sec();
+  conn_t **p = &jobs_head;
+  while (*p != NULL && (*p)->valid <= c->valid)
+    p = &(*p)->next;
+  c->next = *p;
+  *p = c;
+  jobs_queued++;
+  log_msg("Queued graph from %s with %ld valid arcs (queue depth %d)",
+          c->addr, c->valid, jobs_queued);
+  pthread_cond_signal(&jobs_cond);
+  pthread_mutex_unlock(&jobs_mutex);
+}
+
+// Thread per un grafo: uno ogni ARCS_PER_THREAD archi, entro i core liberi
+// meno uno per ogni altro grafo in coda che un runner libero può prendere
+static int threads_for(const conn_t *c) {
+  int runners = config.max_jobs - jobs_running;
+  int others = jobs_queued < runners ? jobs_queued : runners;
+  int idle = cores_free - others > 1 ? cores_free - others : 1;
+  long want = 1 + c->valid / ARCS_PER_THREAD;
+  return want < idle ? (int)want : idle;
+}
+
+// Aspetta un grafo e almeno un core libero. Di solito il più piccolo; se il
+// più vecchio aspetta da più di STARVE_SEC tocca a lui. Ritorna NULL solo
+// dopo lo stop e con la coda vuota
+static conn_t *jobs_pop(int *threads, int *depth, int *running) {
+  pthread_mutex_lock(&jobs_mutex);
+  while (!(jobs_head != NULL && cores_free > 0) &&
+         !(jobs_head == NULL && jobs_stop))
+    pthread_cond_wait(&jobs_cond, &jobs_mutex);
+
+  conn_t *c = NULL;
+  if (jobs_head != NULL) {
+    conn_t **pick = &jobs_head;
+    for (conn_t **p = &jobs_head; *p != NULL; p = &(*p)->next) {
+      if ((*p)->queued_at < (*pick)->queued_at)
+        pick = p;
+    }
+    if (now_sec() - (*pick)->queued_at < STARVE_SEC)
+      pick = &jobs_head;
+
+    c = *pick;
+    *pick = c->next;
+    jobs_queued--;
+    jobs_waiting--;
+    c->admitted = false;
+
+    jobs_running++;
+    *threads = threads_for(c);
+    cores_free -= *threads;
+    *depth = jobs_queued;
+    *running = jobs_running;
+  }
+  pthread_mutex_unlock(&jobs_mutex);
+  return c;
+}
+
+static void jobs_done(int threads) {
+  pthread_mutex_lock(&jobs_mutex);
+  cores_free += threads;
+  jobs_running--;
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&jobs_mutex);
+}
+
+// Sezioni della risposta v2: report, top k e, se richiesto, tutti i rank
+static int write_sections(FILE *out, const conn_t *c, const pr_graph_t *g,
+                          const pr_result_t *res) {
+  int k = c->k > 0 ? (int)c->k : config.K;
+  if (k > res->nodes)
+    k = res->nodes;
+
+  char *text = NULL;
+  size_t len = 0;
+  FILE *report = open_memstream(&text, &len);
+  if (report == NULL)
+    return -1;
+  pr_write_report(report, g, res, &config.params, k);
+  fclose(report);
+  put_section(out, V2_SEC_REPORT, text, len);
+  free(text);
+
+  int *nodes = (int *)malloc(k * sizeof(int));
+  double *values = (double *)malloc(k * sizeof(double));
+  unsigned char *top = (unsigned char *)malloc(4 + (size_t)k * 12);
+  if (nodes == NULL || values == NULL || top == NULL) {
+    free(nodes);
+    free(values);
+    free(top);
+    return -1;
+  }
+  uint32_t num = pr_top_k(res, k, nodes, values);
+  uint32_t le = htole32(num);
+  memcpy(top, &le, 4);
+  for (uint32_t i = 0; i < num; i++) {
+    uint32_t node = htole32(nodes[i]);
+    uint64_t bits;
+    memcpy(&bits, &values[i], 8);
+    bits = htole64(bits);
+    memcpy(top + 4 + i * 12, &node, 4);
+    memcpy(top + 8 + i * 12, &bits, 8);
+  }
+  put_section(out, V2_SEC_TOP, top, 4 + (uint64_t)num * 12);
+  free(nodes);
+  free(values);
+  free(top);
+
+  // Su little-endian i double vanno così come sono
+  if (c->flags & V2_FLAG_RANKS) {
+    uint64_t bytes = (uint64_t)res->nodes * sizeof(double);
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    put_section(out, V2_SEC_RANKS, res->ranks, bytes);
+#else
+    uint64_t *le_ranks = (uint64_t *)malloc(bytes > 0 ? bytes : 1);
+    if (le_ranks == NULL)
+      return -1;
+    memcpy(le_ranks, res->ranks, bytes);
+    for (int i = 0; i < res->nodes; i++)
+      le_ranks[i] = htole64(le_ranks[i]);
+    put_section(out, V2_SEC_RANKS, le_ranks, bytes);
+    free(le_ranks);
+#endif
+  }
+  put_section(out, V2_SEC_END, NULL, 0);
+  return 0;
+}
+
+static void run_job(conn_t *c, pr_pool_t *pool, int threads) {
+  double job_start = now_sec();
+  pr_graph_t *g = pr_builder_finish(c->builder);
+  c->builder = NULL;
+
+  char *text = NULL;
+  size_t len = 0;
+  int code = 0;
+  FILE *out = open_memstream(&text, &len);
+
+  // Il pool del runner ha tutti i core: il calcolo ne usa solo threads
+  pr_params_t params = config.params;
+  params.width = threads;
+  pr_result_t res;
+  int err = 0;
+  if (g == NULL || out == NULL || pr_run(g, &params, pool, &res) != 0) {
+    err = errno;
+  } else {
+    if (c->version == 2 && write_sections(out, c, g, &res) != 0)
+      err = errno;
+    else if (c->version != 2)
+      pr_write_report(out, g, &res, &config.params, config.K);
+    pr_result_free(&res);
+  }
+
+  if (out != NULL)
+    fclose(out);
+  log_msg("pagerank executed with exit code %d", err != 0);
+
+  if (err != 0) {
+    // Solo il messaggio, senza sezioni scritte a metà
+    code = 1;
+    char msg[128];
+    int msg_len = snprintf(msg, sizeof(msg), "Errore calcolo pagerank: %s\n",
+                           strerror(err));
+    set_text(c, code, msg, msg_len);
+    free(text);
+  } else {
+    if (cache != NULL)
+      cache_put(cache, c->key, code, text, len, now_sec() - job_start);
+    set_response(c, code, text, len);
+  }
+  send_response_blocking(c);
+  log_msg("Graph with %u nodes, %ld invalid arcs, %ld valid arcs, pagerank "
+          "exit code %d, %.3fs",
+          c->n, c->invalid, c->valid, code, now_sec() - c->start);
+
+  pr_graph_free(g);
+  conn_free(c);
+}
+
+// Ogni runner tiene per tutta la vita un pool grande quanto tutti i core:
+// un calcolo ne occupa solo i thread assegnati (pr_params_t.width), senza
+// creare e distruggere thread quando l'assegnazione cambia
+static void *job_runner(void *arg) {
+  (void)arg;
+  pr_pool_t *pool = pr_pool_create(config.cores);
+  int threads, depth, running;
+  conn_t *c;
+
+  while ((c = jobs_pop(&threads, &depth, &running)) != NULL) {
+    log_msg("Running graph from %s on %d threads after %.3fs in queue "
+            "(queue depth %d, %d jobs running)",
+            c->addr, threads, now_sec() - c->queued_at, depth, running);
+    run_job(c, pool, threads);
+    jobs_done(threads);
+  }
+
+  pr_pool_destroy(pool);
+  return NULL;
+}
+
+// LETTURA DAI CLIENT
+
+typedef enum { READ_MORE, READ_DONE, READ_CLOSED } read_status_t;
+
+// La risposta viene inviata dal thread epoll dopo il ritorno di READ_CLOSED
+static void reject(conn_t *c, const char *msg) {
+  log_msg("Error handling client: %s", msg);
+  char text[128];
+  int len = snprintf(text, sizeof(text), "%s\n", msg);
+  set_text(c, 1, text, len);
+
+  // Scarta gli archi già arrivati: chiudere con dati non letti manda un
+  // reset che può far perdere la risposta al client
+  char drain[4096];
+  while (recv(c->fd, drain, sizeof(drain), MSG_DONTWAIT) > 0)
+    ;
+}
+
+// Decodifica gli archi completi presenti in buf e li passa al builder
+static void consume_edges(conn_t *c, const unsigned char *buf, size_t len) {
+  int block = 0;
+
+  for (size_t off = 0; off + 8 <= len; off += 8) {
+    uint32_t orig, dest;
+    memcpy(&orig, buf + off, 4);
+    memcpy(&dest, buf + off + 4, 4);
+    orig = le32toh(orig);
+    dest = le32toh(dest);
+
+    if (1 <= orig && orig <= c->n && 1 <= dest && dest <= c->n) {
+      src_block[block] = orig - 1;
+      dst_block[block] = dest - 1;
+      block++;
+      c->valid++;
+    } else {
+      c->invalid++;
+    }
+    c->received++;
+  }
+
+  pr_builder_add(c->builder, src_block, dst_block, block);
+}
+
+// Intestazione completa: controlli, ammissione e builder
+static read_status_t start_graph(conn_t *c) {
+  sha256_update(&c->hash, c->header, c->header_len);
+  uint32_t field[5];
+  memcpy(field, c->header, c->header_len);
+  if (c->version == 2) {
+    c->n = le32toh(field[1]);
+    c->a = le32toh(field[2]);
+    c->k = le32toh(field[3]);
+    c->flags = le32toh(field[4]);
+    log_msg("Received graph with %u nodes and %u arcs (protocol v2)", c->n,
+            c->a);
+  } else {
+    c->n = le32toh(field[0]);
+    c->a = le32toh(field[1]);
+    log_msg("Received graph with %u nodes and %u arcs", c->n, c->a);
+  }
+
+  if (c->n == 0 || c->n > INT32_MAX) {
+    reject(c, "Invalid number of nodes");
+    return READ_CLOSED;
+  }
+  // Più di n risultati non esistono: senza il limite un K enorme farebbe
+  // allocare al runner fino a 12 byte per ogni valore chiesto
+  if (c->k > c->n)
+    c->k = c->n;
+  if (!jobs_admit(c)) {
+    reject(c, "Server busy, retry later");
+    return READ_CLOSED;
+  }
+  c->builder = pr_builder_create(c->n, c->a);
+  if (c->builder == NULL) {
+    reject(c, "Out of memory");
+    return READ_CLOSED;
+  }
+  return READ_MORE;
+}
+
+// Archi v2: frame interi, decompressi se serve, passati al builder a blocchi
+static read_status_t read_frames(conn_t *c) {
+#ifdef HAVE_ZLIB
+  static unsigned char raw_buf[V2_FRAME_MAX];
+#endif
+
+  while (true) {
+    if (c->frame_header_len < 8) {
+      ssize_t r = read(c->fd, c->frame_header + c->frame_header_len,
+                       8 - c->frame_header_len);
+      if (r == 0)
+        return READ_CLOSED;
+      if (r < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? READ_MORE
+                                                       : READ_CLOSED;
+      c->frame_header_len += r;
+      if (c->frame_header_len < 8)
+        continue;
+
+      memcpy(&c->raw_len, c->frame_header, 4);
+      memcpy(&c->comp_len, c->frame_header + 4, 4);
+      c->raw_len = le32toh(c->raw_len);
+      c->comp_len = le32toh(c->comp_len);
+      if (c->raw_len == 0)
+        return READ_DONE;
+      if (c->raw_len % 8 != 0 || c->raw_len > V2_FRAME_MAX ||
+          c->comp_len > V2_COMP_MAX) {
+        reject(c, "Invalid frame");
+        return READ_CLOSED;
+      }
+#ifndef HAVE_ZLIB
+      if (c->comp_len > 0) {
+        reject(c, "Compressed frames not supported");
+        return READ_CLOSED;
+      }
+#endif
+      if (c->frame == NULL) {
+        c->frame = (unsigned char *)malloc(V2_COMP_MAX);
+        if (c->frame == NULL) {
+          reject(c, "Out of memory");
+          return READ_CLOSED;
+        }
+      }
+      c->frame_got = 0;
+    }
+
+    uint32_t size = c->comp_len > 0 ? c->comp_len : c->raw_len;
+    ssize_t r = read(c->fd, c->frame + c->frame_got, size - c->frame_got);
+    if (r == 0)
+      return READ_CLOSED;
+    if (r < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK ? READ_MORE : READ_CLOSED;
+    c->frame_got += r;
+    if (c->frame_got < size)
+      continue;
+
+    const unsigned char *raw = c->frame;
+#ifdef HAVE_ZLIB
+    if (c->comp_len > 0) {
+      uLongf raw_len = V2_FRAME_MAX;
+      if (uncompress(raw_buf, &raw_len, c->frame, c->comp_len) != Z_OK ||
+          raw_len != c->raw_len) {
+        reject(c, "Corrupted frame");
+        return READ_CLOSED;
+      }
+      raw = raw_buf;
+    }
+#endif
+
+    // L'hash copre i dati decompressi: compressi o no, stessa chiave
+    sha256_update(&c->hash, raw, c->raw_len);
+    for (uint32_t off = 0; off < c->raw_len; off += READ_BUF_SIZE) {
+      uint32_t len = c->raw_len - off < READ_BUF_SIZE ? c->raw_len - off
+                                                      : READ_BUF_SIZE;
+      consume_edges(c, raw + off, len);
+    }
+    c->frame_header_len = 0;
+  }
+}
+
+static read_status_t read_client(conn_t *c) {
+  static unsigned char buf[READ_BUF_SIZE + 8];
+
+  while (true) {
+    // I primi 4 byte dicono il protocollo e quindi la lunghezza
+    // dell'intestazione
+    int need = c->header_len < 4 ? 4 : c->version == 2 ? V2_HEADER_SIZE : 8;
+    if (c->header_len < need) {
+      ssize_t r = read(c->fd, c->header + c->header_len, need - c->header_len);
+      if (r == 0)
+        return READ_CLOSED;
+      if (r < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? READ_MORE
+                                                       : READ_CLOSED;
+      c->header_len += r;
+      if (c->header_len == 4) {
+        uint32_t magic;
+        memcpy(&magic, c->header, 4);
+        c->version = le32toh(magic) == V2_MAGIC ? 2 : 1;
+        continue;
+      }
+      if (c->header_len < need)
+        continue;
+
+      if (start_graph(c) == READ_CLOSED)
+        return READ_CLOSED;
+    }
+
+    if (c->version == 2)
+      return read_frames(c);
+
+    if (c->received == c->a)
+      return READ_DONE;
+
+    // Non legge oltre l'ultimo arco atteso
+    size_t remaining = (size_t)(c->a - c->received) * 8 - c->partial_len;
+    size_t want = remaining < READ_BUF_SIZE ? remaining : READ_BUF_SIZE;
+
+    memcpy(buf, c->partial, c->partial_len);
+    ssize_t r = read(c->fd, buf + c->partial_len, want);
+    if (r == 0)
+      return READ_CLOSED;
+    if (r < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK ? READ_MORE : READ_CLOSED;
+
+    sha256_update(&c->hash, buf + c->partial_len, r);
+    size_t len = c->partial_len + r;
+    size_t whole = len - len % 8;
+    consume_edges(c, buf, whole);
+    c->partial_len = len - whole;
+    memcpy(c->partial, buf + whole, c->partial_len);
+  }
+}
+
+// Chiude l'hash aggiungendo i parametri: lo stesso grafo calcolato con
+// parametri diversi ha una chiave diversa
+static void finish_key(conn_t *c) {
+  int32_t k = htole32(config.K);
+  int32_t maxiter = htole32(config.params.maxiter);
+  sha256_update(&c->hash, &k, sizeof(k));
+  sha256_update(&c->hash, &maxiter, sizeof(maxiter));
+  sha256_update(&c->hash, &config.params.damping, sizeof(double));
+  sha256_update(&c->hash, &config.params.eps, sizeof(double));
+  sha256_final(&c->hash, c->key);
+}
+
+// Ritorna true se la risposta è in cache: viene preparata sulla connessione
+// e inviata dal thread epoll
+static bool serve_from_cache(conn_t *c) {
+  if (cache == NULL)
+    return false;
+
+  char hex[2 * SHA256_DIGEST_SIZE + 1];
+  sha256_hex(c->key, hex);
+
+  uint32_t code;
+  char *text;
+  size_t len;
+  double saved;
+  bool hit = cache_get(cache, c->key, &code, &text, &len, &saved);
+
+  cache_counters_t cnt;
+  cache_get_counters(cache, &cnt);
+
+  if (!hit) {
+    log_msg("Cache miss for graph %.16s (hits %ld, misses %ld)", hex,
+            cnt.hits, cnt.misses);
+    return false;
+  }
+
+  set_response(c, code, text, len);
+  log_msg("Cache hit for graph %.16s from %s: saved %.3fs (hits %ld, misses "
+          "%ld, saved %.3fs total)",
+          hex, c->addr, saved, cnt.hits, cnt.misses, cnt.saved);
+  return true;
+}
+
+// SERVER
+
+static int open_listen_socket(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
+    perror("Errore creazione socket.");
+    exit(EXIT_FAILURE);
+  }
+
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("Errore bind.");
+    exit(EXIT_FAILURE);
+  }
+  if (listen(fd, SOMAXCONN) < 0) {
+    perror("Errore listen.");
+    exit(EXIT_FAILURE);
+  }
+
+  return fd;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-p PORT] [-t T] [-k K] [-m M] [-d D] [-e E] "
+          "[-j JOBS] [-q QUEUE] [-l LOGFILE] [-c ENTRIES] [-M CACHEMB] "
+          "[-C CACHEDIR]\n",
+          prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+  int port = DEFAULT_PORT;
+  int T = sysconf(_SC_NPROCESSORS_ONLN);
+  char *logname = "server.log";
+  int cache_entries = 128;
+  long cache_mb = 256;
+  char *cache_dir = NULL;
+  int max_jobs = 0;
+  int max_queue = 64;
+
+  config.K = 3;
+  pr_params_default(&config.params);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:t:k:m:d:e:j:q:l:c:M:C:")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 't':
+      T = atoi(optarg);
+      break;
+    case 'k':
+      config.K = atoi(optarg);
+      break;
+    case 'm':
+      config.params.maxiter = atoi(optarg);
+      break;
+    case 'd':
+      config.params.damping = atof(optarg);
+      break;
+    case 'e':
+      config.params.eps = atof(optarg);
+      break;
+    case 'j':
+      max_jobs = atoi(optarg);
+      if (max_jobs <= 0)
+        usage(argv[0]);
+      break;
+    case 'q':
+      max_queue = atoi(optarg);
+      break;
+    case 'l':
+      logname = optarg;
+      break;
+    case 'c':
+      cache_entries = atoi(optarg);
+      break;
+    case 'M':
+      cache_mb = atol(optarg);
+      break;
+    case 'C':
+      cache_dir = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (T <= 0 || config.K <= 0 || config.params.maxiter <= 0 ||
+      config.params.damping <= 0 || config.params.damping >= 1 || port <= 0 ||
+      cache_entries < 0 || cache_mb <= 0 || max_queue <= 0)
+    usage(argv[0]);
+
+  // Di default un calcolo ogni due core, così ognuno ne ha almeno due; mai
+  // più calcoli che core
+  if (max_jobs == 0)
+    max_jobs = T / 2 > 0 ? T / 2 : 1;
+  config.cores = T;
+  config.max_jobs = max_jobs < T ? max_jobs : T;
+  config.max_queue = max_queue;
+  cores_free = T;
+
+  if (cache_entries > 0)
+    cache = cache_create(cache_entries, (size_t)cache_mb << 20, cache_dir);
+
+  log_file = fopen(logname, "a");
+  if (log_file == NULL) {
+    perror("Errore apertura file di log.");
+    exit(EXIT_FAILURE);
+  }
+
+  // I segnali arrivano solo dal signalfd, tutti i thread li ereditano bloccati
+  sigset_t sigset;
+  sigemptyset(&sigset);
+  sigaddset(&sigset, SIGINT);
+  sigaddset(&sigset, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+  pthread_t *runners =
+      (pthread_t *)malloc(config.max_jobs * sizeof(pthread_t));
+  for (int i = 0; i < config.max_jobs; i++)
+    pthread_create(&runners[i], NULL, job_runner, NULL);
+
+  int epfd = epoll_create1(0);
+  conn_t listen_conn = {.kind = CONN_LISTEN,
+                        .fd = open_listen_socket(port)};
+  conn_t signal_conn = {.kind = CONN_SIGNAL, .fd = signalfd(-1, &sigset, 0)};
+
+  struct epoll_event ev = {.events = EPOLLIN};
+  ev.data.ptr = &listen_conn;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, listen_conn.fd, &ev);
+  ev.data.ptr = &signal_conn;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, signal_conn.fd, &ev);
+
+  log_msg("Server started on port %d (%d cores, up to %d jobs, queue %d)",
+          port, config.cores, config.max_jobs, config.max_queue);
+
+  bool shutting_down = false;
+  int receiving = 0; // Connessioni che stanno ancora inviando il grafo
+  int sending = 0;   // Risposte del thread epoll in attesa di EPOLLOUT
+  struct epoll_event events[MAX_EVENTS];
+
+  while (!shutting_down || receiving > 0 || sending > 0) {
+    int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("Errore epoll_wait.");
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      conn_t *c = (conn_t *)events[i].data.ptr;
+
+      if (c->kind == CONN_SIGNAL) {
+        struct signalfd_siginfo si;
+        if (read(c->fd, &si, sizeof(si)) == sizeof(si) && !shutting_down) {
+          // Come in Python: niente nuove connessioni, si finisce il resto
+          shutting_down = true;
+          epoll_ctl(epfd, EPOLL_CTL_DEL, listen_conn.fd, NULL);
+          close(listen_conn.fd);
+        }
+        continue;
+      }
+
+      if (c->kind == CONN_LISTEN) {
+        struct sockaddr_in peer;
+        socklen_t plen = sizeof(peer);
+        int fd;
+        while ((fd = accept4(listen_conn.fd, (struct sockaddr *)&peer, &plen,
+                             SOCK_NONBLOCK)) >= 0) {
+          conn_t *nc = (conn_t *)calloc(1, sizeof(conn_t));
+          nc->kind = CONN_CLIENT;
+          nc->fd = fd;
+          nc->start = now_sec();
+          sha256_init(&nc->hash);
+          snprintf(nc->addr, sizeof(nc->addr), "('%s', %d)",
+                   inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+          log_msg("Accepted connection from %s", nc->addr);
+
+          struct epoll_event cev = {.events = EPOLLIN | EPOLLRDHUP};
+          cev.data.ptr = nc;
+          epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev);
+          receiving++;
+          plen = sizeof(peer);
+        }
+        continue;
+      }
+
+      // Resto di una risposta (cache o rifiuto): il socket si è svuotato
+      if (c->out_head_len > 0) {
+        if (send_some(c, MSG_DONTWAIT) != 0) {
+          epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+          sending--;
+          conn_free(c);
+        }
+        continue;
+      }
+
+      read_status_t st = read_client(c);
+      if (st == READ_MORE)
+        continue;
+
+      receiving--;
+
+      if (st == READ_DONE) {
+        log_msg("Received %ld valid arcs, %ld invalid arcs from %s in %.3fs",
+                c->valid, c->invalid, c->addr, now_sec() - c->start);
+        finish_key(c);
+        if (serve_from_cache(c)) {
+          jobs_release(c);
+        } else {
+          epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+          jobs_push(c);
+          continue;
+        }
+      } else {
+        if (c->builder != NULL)
+          log_msg("Error handling client: connection closed after %u of %u "
+                  "arcs",
+                  c->received, c->a);
+        jobs_release(c);
+      }
+
+      // Una risposta dal thread epoll non blocca le altre connessioni: quello
+      // che non entra nel socket parte ai successivi EPOLLOUT
+      if (c->out_head_len > 0 && send_some(c, MSG_DONTWAIT) == 0) {
+        struct epoll_event oev = {.events = EPOLLOUT};
+        oev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &oev);
+        sending++;
+        continue;
+      }
+      epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+      conn_free(c);
+    }
+  }
+
+  pthread_mutex_lock(&jobs_mutex);
+  jobs_stop = true;
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&jobs_mutex);
+  for (int i = 0; i < config.max_jobs; i++)
+    pthread_join(runners[i], NULL);
+  free(runners);
+  close(signal_conn.fd);
+
+  if (cache != NULL) {
+    cache_counters_t cnt;
+    cache_get_counters(cache, &cnt);
+    log_msg("Cache: %ld hits (%ld from disk), %ld misses, %.3fs saved",
+            cnt.hits, cnt.disk_hits, cnt.misses, cnt.saved);
+    cache_destroy(cache);
+  }
+  close(epfd);
+
+  log_msg("Server shutdown");
+  printf("Bye dal server\n");
+  fclose(log_file);
+
+  return 0;
+}
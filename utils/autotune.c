@@ -0,0 +1,118 @@
+#include "autotune.h"
+#include "stats.h"
+#include "threadpool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+// Nodi più archi per thread sotto cui un thread in più costa più di quanto
+// rende (attesa del pool due volte per iterazione)
+#define AUTOTUNE_WORK_PER_THREAD (1 << 17)
+
+// Lavori per thread, come pagerank_grain
+#define AUTOTUNE_CHUNKS_PER_THREAD 4
+
+// Oltre questo rapporto tra lavoro massimo e medio si bilanciano gli archi
+#define AUTOTUNE_MAX_IMBALANCE 1.25
+
+// Iterazioni misurate per ogni candidato della calibrazione
+#define AUTOTUNE_CALIB_ITERS 3
+
+int autotune_cores(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+}
+
+static int grain_for(int N, int threads) {
+  int chunks = threads * AUTOTUNE_CHUNKS_PER_THREAD;
+  int grain = (N + chunks - 1) / chunks;
+  return grain > 0 ? grain : 1;
+}
+
+void autotune_graph(const grafo *g, int cores, autotune_t *at) {
+  long arcs = grafo_arcs(g);
+  long work = arcs + g->N;
+
+  at->cores = cores;
+  at->threads = (int)(work / AUTOTUNE_WORK_PER_THREAD);
+  if (at->threads > cores)
+    at->threads = cores;
+  if (at->threads < 1)
+    at->threads = 1;
+  at->grain = grain_for(g->N, at->threads);
+  at->calibrated = false;
+  at->calib_time = 0;
+
+  long max_deg = 0;
+  for (int j = 0; j < g->N; j++) {
+    long deg = g->in_off[j + 1] - g->in_off[j];
+    if (deg > max_deg)
+      max_deg = deg;
+  }
+  at->degree_skew = arcs > 0 ? (double)max_deg * g->N / arcs : 1;
+
+  // Squilibrio dei lavori a nodi costanti: con un solo thread non conta
+  long max_work = 0;
+  int chunks = 0;
+  for (int start = 0; start < g->N; start += at->grain, chunks++) {
+    int end = start + at->grain < g->N ? start + at->grain : g->N;
+    long w = g->in_off[end] - g->in_off[start] + (end - start);
+    if (w > max_work)
+      max_work = w;
+  }
+  at->imbalance = chunks > 0 && work > 0 ? (double)max_work * chunks / work : 1;
+  at->balance_arcs = at->threads > 1 && at->imbalance > AUTOTUNE_MAX_IMBALANCE;
+}
+
+int autotune_calibrate(grafo *g, const pagerank_params_t *params,
+                       autotune_t *at) {
+  int candidates[3] = {at->threads, at->threads / 2, at->threads * 2};
+  pagerank_params_t p = *params;
+  p.maxiter = AUTOTUNE_CALIB_ITERS;
+  p.eps = 0;
+  p.stable_k = 0;
+  p.metrics = NULL;
+  p.balance_arcs = at->balance_arcs;
+
+  int best = at->threads;
+  double best_time = 0;
+  for (int i = 0; i < 3; i++) {
+    int t = candidates[i];
+    if (t < 1 || t > at->cores || (i > 0 && t == candidates[0]))
+      continue;
+
+    thread_pool_t *tpool = tp_create(t);
+    if (tpool == NULL)
+      return -1;
+    p.grain = grain_for(g->N, t);
+    int iters;
+    double start = stats_now();
+    double *X = pagerank_run(g, &p, tpool, &iters, NULL);
+    double elapsed = (stats_now() - start) / AUTOTUNE_CALIB_ITERS;
+    tp_destroy(tpool);
+    if (X == NULL)
+      return -1;
+    free(X);
+
+    if (best_time == 0 || elapsed < best_time) {
+      best = t;
+      best_time = elapsed;
+    }
+  }
+
+  at->threads = best;
+  at->grain = grain_for(g->N, best);
+  at->calibrated = true;
+  at->calib_time = best_time;
+  return 0;
+}
+
+void autotune_report(FILE *f, const grafo *g, const autotune_t *at) {
+  fprintf(f,
+          "Auto-tuned for %d cores (%d nodes, %ld arcs, max in-degree %.1fx "
+          "mean, chunk imbalance %.2f)",
+          at->cores, g->N, grafo_arcs(g), at->degree_skew, at->imbalance);
+  if (at->calibrated)
+    fprintf(f, ", calibrated at %.4fs per iteration", at->calib_time);
+  fprintf(f, ": -t %d --grain %d --balance %s\n", at->threads, at->grain,
+          at->balance_arcs ? "arcs" : "nodes");
+}
@@ -0,0 +1,39 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "graph.h"
+#include "pagerank.h"
+#include <stdio.h>
+
+// Scelta automatica della configurazione del calcolo (-t auto) dalla forma
+// del grafo: thread, nodi per lavoro (grain) e variante del kernel. La
+// configurazione scelta viene riportata con le opzioni che la fissano.
+
+typedef struct {
+  int cores;         // Core disponibili
+  int threads;       // Thread del pool scelti
+  int grain;         // Nodi per lavoro (pagerank_params_t.grain)
+  bool balance_arcs; // Variante del kernel (pagerank_params_t.balance_arcs)
+
+  double degree_skew; // Grado entrante massimo / medio
+  double imbalance;   // Lavoro massimo / medio dei lavori a nodi costanti
+  bool calibrated;    // threads scelto misurando le prime iterazioni
+  double calib_time;  // Secondi per iterazione della scelta calibrata
+} autotune_t;
+
+// Thread per il loader quando il grafo non è ancora noto: tutti i core
+int autotune_cores(void);
+
+// Scelta euristica: un thread ogni AUTOTUNE_WORK_PER_THREAD nodi più archi,
+// quattro lavori per thread, lavori a nodi più archi costanti se quelli a
+// nodi costanti sono sbilanciati oltre AUTOTUNE_MAX_IMBALANCE
+void autotune_graph(const grafo *g, int cores, autotune_t *at);
+
+// Misura le prime iterazioni con il numero di thread scelto, la metà e il
+// doppio (entro i core) e tiene il più veloce. -1 se manca memoria
+int autotune_calibrate(grafo *g, const pagerank_params_t *params,
+                       autotune_t *at);
+
+void autotune_report(FILE *f, const grafo *g, const autotune_t *at);
+
+#endif // AUTOTUNE_H
@@ -0,0 +1,195 @@
+#include "batch.h"
+#include "graph.h"
+#include "loader.h"
+#include "stats.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Un grafo del batch: caricato dal thread di prefetch, poi calcolato
+typedef struct {
+  char *path;
+  int loader_threads;
+  grafo *g;
+  int err;     // errno dell'apertura o del caricamento, 0 se caricato
+  double load; // Secondi di caricamento
+  pthread_t thread;
+} batch_slot_t;
+
+static void *prefetch_thread(void *arg) {
+  batch_slot_t *s = (batch_slot_t *)arg;
+  double start = stats_now();
+  FILE *file = fopen(s->path, "r");
+  if (file == NULL) {
+    s->err = errno;
+    return NULL;
+  }
+  // Un file malformato dà una riga con error come uno che non si apre
+  s->g = load_graph_stream(file, s->loader_threads, NULL);
+  if (s->g == NULL)
+    s->err = errno != 0 ? errno : EINVAL;
+  fclose(file);
+  s->load = stats_now() - start;
+  return NULL;
+}
+
+// Prossimo percorso della lista, senza il ritorno a capo. NULL a fine lista
+static char *next_path(FILE *list) {
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t n;
+  while ((n = getline(&line, &len, list)) != -1) {
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+      line[--n] = '\0';
+    if (n > 0 && line[0] != '#')
+      return line;
+  }
+  free(line);
+  return NULL;
+}
+
+static batch_slot_t *start_slot(FILE *list, int loader_threads) {
+  char *path = next_path(list);
+  if (path == NULL)
+    return NULL;
+  batch_slot_t *s = (batch_slot_t *)calloc(1, sizeof(batch_slot_t));
+  if (s == NULL) {
+    free(path);
+    return NULL;
+  }
+  s->path = path;
+  s->loader_threads = loader_threads;
+  pthread_create(&s->thread, NULL, prefetch_thread, s);
+  return s;
+}
+
+static void print_string(FILE *out, const char *str) {
+  fputc('"', out);
+  for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf(out, "\\u%04x", *c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+static void print_record(FILE *out, const batch_slot_t *s, const double *X,
+                         int iter, int maxiter, bool stable_stop, int K,
+                         const int *top, double compute) {
+  const grafo *g = s->g;
+  int dead_end = 0;
+  double ranks_sum = 0;
+  for (int i = 0; i < g->N; i++) {
+    if (g->out[i] == 0)
+      dead_end++;
+    ranks_sum += X[i];
+  }
+
+  fprintf(out, "{\"file\": ");
+  print_string(out, s->path);
+  fprintf(out,
+          ", \"nodes\": %d, \"dead_end_nodes\": %d, \"valid_arcs\": %ld, "
+          "\"iterations\": %d, \"converged\": %s, \"stop_reason\": \"%s\", "
+          "\"ranks_sum\": %.6f, \"load\": %.6f, \"pagerank\": %.6f, "
+          "\"top\": [",
+          g->N, dead_end, grafo_arcs(g), iter,
+          iter < maxiter && !stable_stop ? "true" : "false",
+          stable_stop       ? "stable_top_k"
+          : iter < maxiter ? "converged"
+                           : "max_iterations",
+          ranks_sum, s->load, compute);
+  for (int i = 0; i < K; i++)
+    fprintf(out, "%s[%d, %.9g]", i > 0 ? ", " : "", top[i], X[top[i]]);
+  fprintf(out, "]}\n");
+}
+
+int pagerank_batch(FILE *list, const pagerank_params_t *params, int threads,
+                   int K, FILE *out, batch_summary_t *summary) {
+  double start = stats_now();
+  memset(summary, 0, sizeof(*summary));
+
+  pagerank_workspace_t ws = {0};
+  pagerank_params_t p = *params;
+  p.ws = &ws;
+
+  thread_pool_t *tpool = tp_create(threads);
+  int loader_threads = threads > 1 ? threads / 2 : 1;
+  int top_cap = 0;
+  int *top = NULL;
+  int ret = 0;
+
+  batch_slot_t *cur = start_slot(list, loader_threads);
+  while (cur != NULL) {
+    pthread_join(cur->thread, NULL);
+
+    // Il caricamento del successivo procede mentre questo itera
+    batch_slot_t *next = start_slot(list, loader_threads);
+
+    if (cur->g == NULL) {
+      fprintf(out, "{\"file\": ");
+      print_string(out, cur->path);
+      fprintf(out, ", \"error\": ");
+      print_string(out, strerror(cur->err));
+      fprintf(out, "}\n");
+      summary->failed++;
+    } else {
+      grafo *g = cur->g;
+      double t = stats_now();
+      int iter;
+      bool small = g->N + grafo_arcs(g) <= PAGERANK_SEQUENTIAL_WORK;
+      // Senza cronometri: serve solo a sapere se --stable ha fermato il
+      // calcolo
+      stats_t st;
+      stats_init(&st, false);
+      double *X = pagerank_run(g, &p, small ? NULL : tpool, &iter, &st);
+      stats_destroy(&st);
+
+      int k = K < g->N ? K : g->N;
+      if (k > top_cap) {
+        free(top);
+        top = (int *)malloc(k * sizeof(int));
+        top_cap = k;
+      }
+      if (X == NULL || (k > 0 && top == NULL)) {
+        free(X);
+        ret = -1;
+      } else {
+        pagerank_top_k(X, g->N, k, top);
+        double compute = stats_now() - t;
+        print_record(out, cur, X, iter, p.maxiter, st.stable_stop, k, top,
+                     compute);
+        fflush(out);
+        free(X);
+        summary->graphs++;
+        summary->load += cur->load;
+        summary->compute += compute;
+      }
+      free_grafo(g);
+    }
+    free(cur->path);
+    free(cur);
+    cur = next;
+
+    // Senza memoria si attende il prefetch già partito e ci si ferma
+    if (ret != 0 && cur != NULL) {
+      pthread_join(cur->thread, NULL);
+      if (cur->g != NULL)
+        free_grafo(cur->g);
+      free(cur->path);
+      free(cur);
+      cur = NULL;
+    }
+  }
+
+  free(top);
+  pagerank_workspace_free(&ws);
+  tp_destroy(tpool);
+  summary->wall = stats_now() - start;
+  return ret;
+}
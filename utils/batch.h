@@ -0,0 +1,28 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "pagerank.h"
+#include <stdio.h>
+
+// Modalità batch (--batch): molti grafi in un solo processo. Il thread pool
+// resta attivo per tutto il batch e il grafo successivo viene caricato da un
+// thread a parte mentre quello corrente itera; i vettori di lavoro passano
+// da un grafo all'altro con un pagerank_workspace_t.
+
+typedef struct {
+  int graphs;     // Grafi calcolati
+  int failed;     // File che non si sono potuti aprire
+  double load;    // Somma dei tempi di caricamento
+  double compute; // Somma dei tempi di calcolo, top K e stampa
+  double wall;    // Durata dell'intero batch
+} batch_summary_t;
+
+// Legge da list un percorso per riga (righe vuote e che iniziano con '#'
+// ignorate) e scrive su out un record JSON per grafo, nell'ordine della
+// lista. threads thread per il pool; il caricamento in anticipo usa metà dei
+// thread per i consumer. params->ws viene ignorato. Ritorna 0 o -1 se manca
+// memoria
+int pagerank_batch(FILE *list, const pagerank_params_t *params, int threads,
+                   int K, FILE *out, batch_summary_t *summary);
+
+#endif // BATCH_H
@@ -0,0 +1,328 @@
+#include "cache.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Intestazione dei file su disco
+#define CACHE_MAGIC "PRC1"
+
+typedef struct {
+  char magic[4];
+  uint32_t code;
+  double compute_time;
+  uint64_t len;
+} cache_file_header_t;
+
+static int bucket_of(cache_t *cache, const unsigned char *key) {
+  uint64_t h;
+  memcpy(&h, key, sizeof(h)); // Il digest è già uniforme
+  return (int)(h % (uint64_t)cache->buckets_num);
+}
+
+cache_t *cache_create(int capacity, size_t max_bytes, const char *dir) {
+  if (capacity <= 0 || max_bytes == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  cache_t *cache = (cache_t *)calloc(1, sizeof(cache_t));
+  if (cache == NULL) {
+    perror("Errore allocazione cache.");
+    exit(EXIT_FAILURE);
+  }
+
+  cache->capacity = capacity;
+  cache->max_bytes = max_bytes;
+  cache->buckets_num = capacity * 2 + 1;
+  cache->buckets =
+      (cache_entry_t **)calloc(cache->buckets_num, sizeof(cache_entry_t *));
+  if (cache->buckets == NULL) {
+    perror("Errore allocazione cache.");
+    exit(EXIT_FAILURE);
+  }
+
+  if (dir != NULL) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+      perror("Errore creazione cartella cache.");
+      exit(EXIT_FAILURE);
+    }
+    cache->dir = strdup(dir);
+  }
+
+  pthread_mutex_init(&cache->mutex, NULL);
+  return cache;
+}
+
+static void entry_free(cache_entry_t *e) {
+  free(e->text);
+  free(e);
+}
+
+void cache_destroy(cache_t *cache) {
+  if (cache == NULL) {
+    return;
+  }
+
+  cache_entry_t *e = cache->head;
+  while (e != NULL) {
+    cache_entry_t *next = e->next;
+    entry_free(e);
+    e = next;
+  }
+
+  pthread_mutex_destroy(&cache->mutex);
+  free(cache->buckets);
+  free(cache->dir);
+  free(cache);
+}
+
+// STRUMENTI LRU (da chiamare con il mutex preso)
+
+static void lru_unlink(cache_t *cache, cache_entry_t *e) {
+  if (e->prev != NULL)
+    e->prev->next = e->next;
+  else
+    cache->head = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  else
+    cache->tail = e->prev;
+  e->prev = NULL;
+  e->next = NULL;
+}
+
+static void lru_push_front(cache_t *cache, cache_entry_t *e) {
+  e->prev = NULL;
+  e->next = cache->head;
+  if (cache->head != NULL)
+    cache->head->prev = e;
+  cache->head = e;
+  if (cache->tail == NULL)
+    cache->tail = e;
+}
+
+static cache_entry_t *lookup(cache_t *cache, const unsigned char *key) {
+  cache_entry_t *e = cache->buckets[bucket_of(cache, key)];
+  while (e != NULL && memcmp(e->key, key, SHA256_DIGEST_SIZE) != 0)
+    e = e->bucket_next;
+  return e;
+}
+
+static void evict_tail(cache_t *cache) {
+  cache_entry_t *e = cache->tail;
+  if (e == NULL)
+    return;
+
+  lru_unlink(cache, e);
+
+  cache_entry_t **p = &cache->buckets[bucket_of(cache, e->key)];
+  while (*p != e)
+    p = &(*p)->bucket_next;
+  *p = e->bucket_next;
+
+  cache->count--;
+  cache->bytes -= e->len;
+  entry_free(e);
+}
+
+// Inserisce in memoria prendendo possesso di text
+static void insert(cache_t *cache, const unsigned char *key, uint32_t code,
+                   char *text, size_t len, double compute_time) {
+  cache_entry_t *e = lookup(cache, key);
+  if (e != NULL) {
+    free(text);
+    lru_unlink(cache, e);
+    lru_push_front(cache, e);
+    return;
+  }
+
+  // Con tutti i rank una risposta è di 8 byte per nodo: il solo numero di
+  // elementi non basta a limitare la memoria
+  if (len > cache->max_bytes) {
+    free(text);
+    return;
+  }
+  while (cache->count == cache->capacity ||
+         cache->bytes + len > cache->max_bytes)
+    evict_tail(cache);
+
+  e = (cache_entry_t *)calloc(1, sizeof(cache_entry_t));
+  if (e == NULL) {
+    free(text);
+    return;
+  }
+  memcpy(e->key, key, SHA256_DIGEST_SIZE);
+  e->code = code;
+  e->text = text;
+  e->len = len;
+  e->compute_time = compute_time;
+
+  int b = bucket_of(cache, key);
+  e->bucket_next = cache->buckets[b];
+  cache->buckets[b] = e;
+  lru_push_front(cache, e);
+  cache->count++;
+  cache->bytes += len;
+}
+
+// STRUMENTI DISCO
+
+static char *entry_path(cache_t *cache, const unsigned char *key,
+                        const char *suffix) {
+  char hex[2 * SHA256_DIGEST_SIZE + 1];
+  sha256_hex(key, hex);
+
+  size_t size = strlen(cache->dir) + strlen(hex) + strlen(suffix) + 2;
+  char *path = (char *)malloc(size);
+  if (path != NULL)
+    snprintf(path, size, "%s/%s%s", cache->dir, hex, suffix);
+  return path;
+}
+
+static bool disk_read(cache_t *cache, const unsigned char *key, uint32_t *code,
+                      char **text, size_t *len, double *compute_time) {
+  char *path = entry_path(cache, key, ".res");
+  if (path == NULL)
+    return false;
+
+  FILE *f = fopen(path, "rb");
+  free(path);
+  if (f == NULL)
+    return false;
+
+  cache_file_header_t h;
+  bool ok = fread(&h, sizeof(h), 1, f) == 1 &&
+            memcmp(h.magic, CACHE_MAGIC, 4) == 0;
+  char *buf = NULL;
+  if (ok) {
+    buf = (char *)malloc(h.len + 1);
+    ok = buf != NULL && fread(buf, 1, h.len, f) == h.len;
+  }
+  fclose(f);
+
+  if (!ok) {
+    free(buf);
+    return false;
+  }
+
+  buf[h.len] = '\0';
+  *code = h.code;
+  *text = buf;
+  *len = h.len;
+  *compute_time = h.compute_time;
+  return true;
+}
+
+// Scrittura atomica: file temporaneo e rename
+static void disk_write(cache_t *cache, const unsigned char *key, uint32_t code,
+                       const char *text, size_t len, double compute_time) {
+  char suffix[48];
+  snprintf(suffix, sizeof(suffix), ".tmp.%d.%lx", (int)getpid(),
+           (unsigned long)pthread_self());
+  char *tmp = entry_path(cache, key, suffix);
+  char *path = entry_path(cache, key, ".res");
+  if (tmp == NULL || path == NULL) {
+    free(tmp);
+    free(path);
+    return;
+  }
+
+  FILE *f = fopen(tmp, "wb");
+  if (f != NULL) {
+    cache_file_header_t h = {.code = code,
+                             .compute_time = compute_time,
+                             .len = len};
+    memcpy(h.magic, CACHE_MAGIC, 4);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(text, 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0)
+      unlink(tmp);
+  }
+
+  free(tmp);
+  free(path);
+}
+
+// API
+
+bool cache_get(cache_t *cache, const unsigned char *key, uint32_t *code,
+               char **text, size_t *len, double *saved) {
+  pthread_mutex_lock(&cache->mutex);
+
+  cache_entry_t *e = lookup(cache, key);
+  if (e != NULL) {
+    char *copy = (char *)malloc(e->len + 1);
+    if (copy != NULL) {
+      memcpy(copy, e->text, e->len);
+      copy[e->len] = '\0';
+      lru_unlink(cache, e);
+      lru_push_front(cache, e);
+
+      *code = e->code;
+      *text = copy;
+      *len = e->len;
+      *saved = e->compute_time;
+      cache->hits++;
+      cache->saved += e->compute_time;
+      pthread_mutex_unlock(&cache->mutex);
+      return true;
+    }
+  }
+
+  if (cache->dir != NULL) {
+    char *buf;
+    size_t buf_len;
+    double compute_time;
+    if (disk_read(cache, key, code, &buf, &buf_len, &compute_time)) {
+      char *copy = (char *)malloc(buf_len + 1);
+      if (copy != NULL) {
+        memcpy(copy, buf, buf_len + 1);
+        insert(cache, key, *code, buf, buf_len, compute_time);
+
+        *text = copy;
+        *len = buf_len;
+        *saved = compute_time;
+        cache->hits++;
+        cache->disk_hits++;
+        cache->saved += compute_time;
+        pthread_mutex_unlock(&cache->mutex);
+        return true;
+      }
+      free(buf);
+    }
+  }
+
+  cache->misses++;
+  pthread_mutex_unlock(&cache->mutex);
+  return false;
+}
+
+void cache_put(cache_t *cache, const unsigned char *key, uint32_t code,
+               const char *text, size_t len, double compute_time) {
+  char *copy = (char *)malloc(len + 1);
+  if (copy == NULL)
+    return;
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+
+  pthread_mutex_lock(&cache->mutex);
+  insert(cache, key, code, copy, len, compute_time);
+  pthread_mutex_unlock(&cache->mutex);
+
+  // Il file ha un nome unico per chiave, non serve tenere il mutex
+  if (cache->dir != NULL)
+    disk_write(cache, key, code, text, len, compute_time);
+}
+
+void cache_get_counters(cache_t *cache, cache_counters_t *out) {
+  pthread_mutex_lock(&cache->mutex);
+  out->hits = cache->hits;
+  out->disk_hits = cache->disk_hits;
+  out->misses = cache->misses;
+  out->saved = cache->saved;
+  pthread_mutex_unlock(&cache->mutex);
+}
@@ -0,0 +1,71 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "sha256.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cache dei risultati indirizzata per contenuto: la chiave è lo SHA-256 del
+// grafo ricevuto e dei parametri di calcolo. In memoria è un LRU limitato a
+// capacity elementi e a max_bytes byte di risposte; se dir non è NULL ogni
+// risultato viene anche salvato su disco in dir/<chiave>.res e riletto dopo un
+// riavvio o un'espulsione.
+
+typedef struct cache_entry {
+  unsigned char key[SHA256_DIGEST_SIZE];
+  uint32_t code;
+  char *text;
+  size_t len;
+  double compute_time; // Secondi risparmiati ad ogni hit
+  struct cache_entry *prev;
+  struct cache_entry *next;
+  struct cache_entry *bucket_next;
+} cache_entry_t;
+
+typedef struct {
+  int capacity;
+  int count;
+  size_t max_bytes;
+  size_t bytes; // Somma delle len in memoria
+  char *dir;
+
+  cache_entry_t **buckets;
+  int buckets_num;
+  cache_entry_t *head; // Più recente
+  cache_entry_t *tail; // Prossimo da espellere
+
+  long hits;
+  long disk_hits;
+  long misses;
+  double saved;
+
+  pthread_mutex_t mutex;
+} cache_t;
+
+typedef struct {
+  long hits;
+  long disk_hits;
+  long misses;
+  double saved;
+} cache_counters_t;
+
+// capacity e max_bytes devono essere > 0, dir può essere NULL
+cache_t *cache_create(int capacity, size_t max_bytes, const char *dir);
+void cache_destroy(cache_t *cache);
+
+// In caso di hit copia la risposta in *text (da liberare con free) e ritorna
+// true; saved riceve il tempo di calcolo risparmiato. Aggiorna i contatori
+bool cache_get(cache_t *cache, const unsigned char *key, uint32_t *code,
+               char **text, size_t *len, double *saved);
+
+// Inserisce una copia della risposta, espellendo le meno recenti finché
+// numero e byte rientrano nei limiti. Una risposta più grande di max_bytes
+// non resta in memoria (su disco sì, se c'è dir)
+void cache_put(cache_t *cache, const unsigned char *key, uint32_t code,
+               const char *text, size_t len, double compute_time);
+
+void cache_get_counters(cache_t *cache, cache_counters_t *out);
+
+#endif // CACHE_H
@@ -0,0 +1,190 @@
+#include "compact.h"
+#include "decompress.h"
+#include "loader.h"
+#include "pagerank.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Come LOADER_STREAM_BUFFER
+#define COMPACT_STREAM_BUFFER (1 << 20)
+
+// Archi validi letti dallo stream e nodi che vi compaiono
+typedef struct {
+  int N;
+  int *src;
+  int *dst;
+  long num;
+  long cap;
+  uint64_t *used; // Bitmap degli id usati, un bit per id
+} edge_sink_t;
+
+static void *xrealloc(void *ptr, size_t size) {
+  void *p = realloc(ptr, size);
+  if (p == NULL) {
+    perror("Errore allocazione archi.");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+// Stesso filtro di insert_inmap: self-loop e id fuori intervallo non creano
+// archi, quindi non rendono un nodo "usato"
+static void collect_edge(void *arg, int in, int out) {
+  edge_sink_t *e = (edge_sink_t *)arg;
+  if (in >= e->N || out >= e->N || in == out)
+    return;
+
+  if (e->num == e->cap) {
+    e->cap = e->cap ? e->cap * 2 : 1 << 16;
+    e->src = (int *)xrealloc(e->src, e->cap * sizeof(int));
+    e->dst = (int *)xrealloc(e->dst, e->cap * sizeof(int));
+  }
+  e->src[e->num] = in;
+  e->dst[e->num] = out;
+  e->num++;
+
+  e->used[in >> 6] |= 1ull << (in & 63);
+  e->used[out >> 6] |= 1ull << (out & 63);
+}
+
+compact_graph_t *load_graph_compact(FILE *src, int thread_num,
+                                    stats_t *stats) {
+  setvbuf(src, NULL, _IOFBF, COMPACT_STREAM_BUFFER);
+  FILE *file;
+  decompressor_t *dec = decompress_open(src, thread_num, &file);
+  if (dec != NULL)
+    setvbuf(file, NULL, _IOFBF, COMPACT_STREAM_BUFFER);
+
+  stats_begin(stats, PHASE_READ_SIZE);
+  stream_header_t h;
+  int N = file != NULL ? read_stream_header(file, &h) : -1;
+  if (N < 0) {
+    perror("Errore caricamento grafo");
+    exit(EXIT_FAILURE);
+  }
+  stats_end(stats, PHASE_READ_SIZE);
+
+  // Un bit per id al posto di un edges_array_t per id
+  stats_begin(stats, PHASE_ALLOC);
+  long words = ((long)N + 63) / 64;
+  edge_sink_t e = {.N = N};
+  e.used = (uint64_t *)calloc(words > 0 ? words : 1, sizeof(uint64_t));
+  if (e.used == NULL) {
+    perror("Errore allocazione bitmap.");
+    exit(EXIT_FAILURE);
+  }
+  stats_end(stats, PHASE_ALLOC);
+
+  stats_begin(stats, PHASE_PARSE);
+  long edges_read = read_stream_edges(file, &h, collect_edge, &e);
+  if (decompress_close(dec) != 0 || edges_read < 0) {
+    perror("Errore caricamento grafo");
+    exit(EXIT_FAILURE);
+  }
+  stats_end(stats, PHASE_PARSE);
+
+  stats_begin(stats, PHASE_BUILD);
+  // Nuovo id = numero di id usati minori: base per parola più popcount
+  uint32_t *base =
+      (uint32_t *)malloc((words > 0 ? words : 1) * sizeof(uint32_t));
+  if (base == NULL) {
+    perror("Errore allocazione bitmap.");
+    exit(EXIT_FAILURE);
+  }
+  uint32_t M = 0;
+  for (long w = 0; w < words; w++) {
+    base[w] = M;
+    M += __builtin_popcountll(e.used[w]);
+  }
+
+  compact_graph_t *c = (compact_graph_t *)calloc(1, sizeof(compact_graph_t));
+  c->N = N;
+  c->ids = (int *)malloc((M > 0 ? M : 1) * sizeof(int));
+  if (c->ids == NULL) {
+    perror("Errore allocazione id.");
+    exit(EXIT_FAILURE);
+  }
+  for (long w = 0; w < words; w++) {
+    uint64_t bits = e.used[w];
+    uint32_t j = base[w];
+    while (bits) {
+      c->ids[j++] = (int)(w * 64 + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+
+  for (long i = 0; i < e.num; i++) {
+    int s = e.src[i];
+    int d = e.dst[i];
+    e.src[i] = base[s >> 6] +
+               __builtin_popcountll(e.used[s >> 6] & ((1ull << (s & 63)) - 1));
+    e.dst[i] = base[d >> 6] +
+               __builtin_popcountll(e.used[d >> 6] & ((1ull << (d & 63)) - 1));
+  }
+  free(base);
+  free(e.used);
+
+  c->g = grafo_from_edges((int)M, e.src, e.dst, e.num);
+  if (c->g == NULL) {
+    perror("Errore allocazione grafo.");
+    exit(EXIT_FAILURE);
+  }
+  free(e.src);
+  free(e.dst);
+  stats_end(stats, PHASE_BUILD);
+
+  if (stats != NULL)
+    stats->edges_read = edges_read;
+
+  return c;
+}
+
+int compact_isolated(const compact_graph_t *c) { return c->N - c->g->N; }
+
+double *compact_expand(const compact_graph_t *c, const double *X) {
+  double *full = (double *)malloc((c->N > 0 ? c->N : 1) * sizeof(double));
+  if (full == NULL) {
+    perror("Errore allocazione rank.");
+    exit(EXIT_FAILURE);
+  }
+
+  double isolated = X[c->g->N];
+  for (int i = 0; i < c->N; i++)
+    full[i] = isolated;
+  for (int j = 0; j < c->g->N; j++)
+    full[c->ids[j]] = X[j];
+
+  return full;
+}
+
+void compact_report(FILE *f, const compact_graph_t *c, const double *X,
+                    int numiter, int maxiter, bool stable_stop, int K,
+                    const int *top) {
+  int dead_end = compact_isolated(c);
+  for (int j = 0; j < c->g->N; j++) {
+    if (c->g->out[j] == 0)
+      dead_end++;
+  }
+
+  double ranks_sum = 0;
+  for (int i = 0; i < c->N; i++)
+    ranks_sum += X[i];
+
+  int shown = K <= c->N ? K : 0;
+  double *top_rank = (double *)malloc((shown > 0 ? shown : 1) * sizeof(double));
+  for (int i = 0; i < shown; i++)
+    top_rank[i] = X[top[i]];
+
+  pagerank_report_values(f, c->N, dead_end, grafo_arcs(c->g), ranks_sum,
+                         numiter, maxiter, stable_stop, K, top, top_rank);
+  free(top_rank);
+}
+
+void compact_free(compact_graph_t *c) {
+  if (c == NULL)
+    return;
+  free_grafo(c->g);
+  free(c->ids);
+  free(c);
+}
@@ -0,0 +1,41 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include "graph.h"
+#include "stats.h"
+#include <stdio.h>
+
+// Compattazione degli id: per input con spazi di id sparsi (la maggior parte
+// degli id dell'intestazione non compare in nessun arco) il grafo viene
+// costruito solo sui nodi usati, rinumerati 0..M-1 nello stesso ordine.
+// Gli N - M nodi isolati non hanno archi: ricevono solo la parte uniforme
+// (teletrasporto e massa dei dead-end), quindi hanno tutti lo stesso rank e
+// pagerank_run li tratta come un unico valore (pagerank_params_t.isolated).
+
+typedef struct {
+  int N;    // Nodi dell'intestazione
+  int *ids; // ids[j] = id originale del nodo compatto j, crescenti
+  grafo *g; // Grafo sui nodi usati
+} compact_graph_t;
+
+// Legge lo stream (stessi formati di load_graph_stream, anche compressi)
+// senza allocare strutture per gli id mai usati. Lo stream non viene chiuso
+compact_graph_t *load_graph_compact(FILE *file, int thread_num,
+                                    stats_t *stats);
+
+// Nodi isolati esclusi dal grafo compattato
+int compact_isolated(const compact_graph_t *c);
+
+// Vettore degli N rank negli id originali da quello di pagerank_run con
+// isolated = compact_isolated(c), che ha g->N + 1 elementi
+double *compact_expand(const compact_graph_t *c, const double *X);
+
+// Come pagerank_report, con conteggi riferiti agli N nodi originali. X è il
+// vettore espanso
+void compact_report(FILE *f, const compact_graph_t *c, const double *X,
+                    int numiter, int maxiter, bool stable_stop, int K,
+                    const int *top);
+
+void compact_free(compact_graph_t *c);
+
+#endif // COMPACT_H
@@ -0,0 +1,354 @@
+#include "components.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Nodi per lavoro nella ricerca delle componenti
+#define COMP_JOB_NODES (1 << 16)
+
+// Componenti da almeno tanti nodi usano tutto il thread pool; le altre
+// vengono raggruppate in lavori da circa tanti nodi
+#define COMP_POOL_NODES (1 << 15)
+
+typedef struct {
+  const grafo *g;
+  int *parent;
+  const int *comp;
+  const components_t *cc;
+  int start;
+  int end;
+} find_job_t;
+
+typedef struct {
+  const components_t *cc;
+  const pagerank_params_t *params;
+  double *y; // Rank di ogni componente presa da sola, negli id di h
+  int first; // Componenti [first, last)
+  int last;
+  int iters; // Iterazioni della componente più lenta del gruppo
+} batch_job_t;
+
+// Union-find senza lock: il padre ha sempre id minore o uguale, quindi la
+// radice è il nodo minimo della componente. Il dimezzamento dei cammini può
+// perdere una scrittura concorrente, ma sostituisce solo un antenato con un
+// altro
+static int uf_find(int *parent, int x) {
+  for (;;) {
+    int p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+    if (p == x)
+      return x;
+    int gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+    if (gp != p)
+      __atomic_compare_exchange_n(&parent[x], &p, gp, false, __ATOMIC_RELAXED,
+                                  __ATOMIC_RELAXED);
+    x = gp;
+  }
+}
+
+static void uf_union(int *parent, int a, int b) {
+  for (;;) {
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    if (a == b)
+      return;
+    if (a < b) {
+      int t = a;
+      a = b;
+      b = t;
+    }
+    // Fallisce se nel frattempo a è stata agganciata altrove: si riprova
+    int expected = a;
+    if (__atomic_compare_exchange_n(&parent[a], &expected, b, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      return;
+  }
+}
+
+static void union_job(void *arg) {
+  find_job_t *j = (find_job_t *)arg;
+  const grafo *g = j->g;
+  for (int v = j->start; v < j->end; v++) {
+    for (long k = g->in_off[v]; k < g->in_off[v + 1]; k++)
+      uf_union(j->parent, g->in_idx[k], v);
+  }
+}
+
+// Copia le liste entranti in h, con gli id relativi alla componente
+static void fill_job(void *arg) {
+  find_job_t *j = (find_job_t *)arg;
+  const grafo *g = j->g;
+  const components_t *cc = j->cc;
+  for (int v = j->start; v < j->end; v++) {
+    int base = cc->off[j->comp[v]];
+    long k = cc->h->in_off[cc->pos[v]];
+    for (long e = g->in_off[v]; e < g->in_off[v + 1]; e++)
+      cc->h->in_idx[k++] = cc->pos[g->in_idx[e]] - base;
+  }
+}
+
+// Vista della componente k dentro h, senza copie
+static grafo component_view(const components_t *cc, int k) {
+  int o = cc->off[k];
+  return (grafo){.N = cc->off[k + 1] - o,
+                 .out = cc->h->out + o,
+                 .in_off = cc->h->in_off + o,
+                 .in_idx = cc->h->in_idx};
+}
+
+components_t *components_find(const grafo *g, thread_pool_t *tpool) {
+  int N = g->N;
+  components_t *cc = (components_t *)calloc(1, sizeof(components_t));
+  int *parent = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+  int *comp = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+  int jobs_num = (N + COMP_JOB_NODES - 1) / COMP_JOB_NODES;
+  find_job_t *jobs =
+      (find_job_t *)calloc(jobs_num > 0 ? jobs_num : 1, sizeof(find_job_t));
+  if (cc != NULL) {
+    cc->pos = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+    cc->h = (grafo *)calloc(1, sizeof(grafo));
+  }
+  if (cc == NULL || parent == NULL || comp == NULL || jobs == NULL ||
+      cc->pos == NULL || cc->h == NULL) {
+    free(parent);
+    free(comp);
+    free(jobs);
+    components_free(cc);
+    return NULL;
+  }
+
+  for (int v = 0; v < N; v++)
+    parent[v] = v;
+  for (int i = 0; i < jobs_num; i++) {
+    jobs[i] = (find_job_t){.g = g,
+                           .parent = parent,
+                           .comp = comp,
+                           .cc = cc,
+                           .start = i * COMP_JOB_NODES,
+                           .end = (i + 1) * COMP_JOB_NODES < N
+                                      ? (i + 1) * COMP_JOB_NODES
+                                      : N};
+    tp_add_work(tpool, union_job, &jobs[i]);
+  }
+  tp_wait(tpool);
+
+  // La radice precede tutti i nodi della sua componente: riceve l'indice
+  // prima che serva agli altri
+  for (int v = 0; v < N; v++) {
+    int r = uf_find(parent, v);
+    comp[v] = r == v ? cc->num++ : comp[r];
+  }
+
+  cc->off = (int *)calloc((size_t)cc->num + 1, sizeof(int));
+  grafo *h = cc->h;
+  h->N = N;
+  h->out = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+  h->in_off = (long *)malloc(((size_t)N + 1) * sizeof(long));
+  h->in_idx = (int *)malloc((grafo_arcs(g) > 0 ? grafo_arcs(g) : 1) *
+                            sizeof(int));
+  if (cc->off == NULL || h->out == NULL || h->in_off == NULL ||
+      h->in_idx == NULL) {
+    free(parent);
+    free(comp);
+    free(jobs);
+    components_free(cc);
+    return NULL;
+  }
+
+  for (int v = 0; v < N; v++)
+    cc->off[comp[v] + 1]++;
+  for (int k = 0; k < cc->num; k++) {
+    if (cc->off[k + 1] > cc->largest)
+      cc->largest = cc->off[k + 1];
+    cc->off[k + 1] += cc->off[k];
+  }
+
+  // parent fa da cursore per componente
+  memcpy(parent, cc->off, cc->num * sizeof(int));
+  for (int v = 0; v < N; v++) {
+    int p = parent[comp[v]]++;
+    cc->pos[v] = p;
+    h->out[p] = g->out[v];
+    h->in_off[p + 1] = g->in_off[v + 1] - g->in_off[v];
+  }
+  h->in_off[0] = 0;
+  for (int p = 0; p < N; p++)
+    h->in_off[p + 1] += h->in_off[p];
+
+  for (int i = 0; i < jobs_num; i++)
+    tp_add_work(tpool, fill_job, &jobs[i]);
+  tp_wait(tpool);
+
+  free(parent);
+  free(comp);
+  free(jobs);
+  return cc;
+}
+
+// Come pagerank_run, in sequenza sul worker che la chiama. Il risultato
+// finisce in X
+static int solve_sequential(grafo *c, const pagerank_params_t *params,
+                            double *X, double *X_1, double *Y) {
+  double d = params->d;
+  double *X_t = X;
+  double *X_t_1 = X_1;
+  for (int i = 0; i < c->N; i++)
+    X_t[i] = 1.0 / (float)c->N;
+  calcolo_Y(c, X_t, Y);
+  double S = calcolo_S(c, X_t);
+  double first = first_term(c, d);
+
+  int iter = 0;
+  double errore;
+  do {
+    double third = third_term(c, d, S);
+    for (int j = 0; j < c->N; j++)
+      X_t_1[j] = first + second_term(c, j, d, Y) + third;
+    calcolo_errore(c, X_t, X_t_1, &errore);
+
+    double *temp = X_t;
+    X_t = X_t_1;
+    X_t_1 = temp;
+    calcolo_Y(c, X_t, Y);
+    S = calcolo_S(c, X_t);
+    iter++;
+  } while (errore > params->eps && iter < params->maxiter);
+
+  if (X_t != X)
+    memcpy(X, X_t, c->N * sizeof(double));
+  return iter;
+}
+
+static void batch_job(void *arg) {
+  batch_job_t *j = (batch_job_t *)arg;
+  const components_t *cc = j->cc;
+
+  int max = 0;
+  for (int k = j->first; k < j->last; k++) {
+    if (cc->off[k + 1] - cc->off[k] > max)
+      max = cc->off[k + 1] - cc->off[k];
+  }
+  double *X_1 = (double *)malloc(max * sizeof(double));
+  double *Y = (double *)malloc(max * sizeof(double));
+
+  j->iters = 0;
+  for (int k = j->first; k < j->last; k++) {
+    grafo c = component_view(cc, k);
+    double *X = j->y + cc->off[k];
+
+    // Un nodo da solo non ha archi: è un dead-end e tiene tutta la massa
+    if (c.N == 1) {
+      X[0] = 1;
+      continue;
+    }
+    int it = solve_sequential(&c, j->params, X, X_1, Y);
+    if (it > j->iters)
+      j->iters = it;
+  }
+
+  free(X_1);
+  free(Y);
+}
+
+double *pagerank_components(const components_t *cc,
+                            const pagerank_params_t *params,
+                            thread_pool_t *tpool, int *numiter,
+                            stats_t *stats) {
+  const grafo *h = cc->h;
+  int N = h->N;
+  double d = params->d;
+  pagerank_params_t p = *params;
+  p.isolated = 0;
+  p.stable_k = 0;
+  p.reduced = NULL;
+
+  double *y = (double *)malloc((N > 0 ? N : 1) * sizeof(double));
+  batch_job_t *jobs =
+      (batch_job_t *)calloc(cc->num > 0 ? cc->num : 1, sizeof(batch_job_t));
+  double *X = (double *)malloc((N + 1) * sizeof(double));
+  if (y == NULL || jobs == NULL || X == NULL) {
+    free(y);
+    free(jobs);
+    free(X);
+    return NULL;
+  }
+
+  // Componenti piccole a gruppi consecutivi, ognuno su un worker
+  int jobs_num = 0;
+  for (int k = 0; k < cc->num;) {
+    if (cc->off[k + 1] - cc->off[k] >= COMP_POOL_NODES) {
+      k++;
+      continue;
+    }
+    int first = k;
+    int nodes = 0;
+    while (k < cc->num && nodes < COMP_POOL_NODES &&
+           cc->off[k + 1] - cc->off[k] < COMP_POOL_NODES) {
+      nodes += cc->off[k + 1] - cc->off[k];
+      k++;
+    }
+    jobs[jobs_num] = (batch_job_t){
+        .cc = cc, .params = &p, .y = y, .first = first, .last = k};
+    tp_add_work(tpool, batch_job, &jobs[jobs_num++]);
+  }
+  tp_wait(tpool);
+
+  *numiter = 0;
+  for (int i = 0; i < jobs_num; i++) {
+    if (jobs[i].iters > *numiter)
+      *numiter = jobs[i].iters;
+  }
+
+  // Componenti grandi una alla volta, ognuna con tutto il pool. Solo la più
+  // grande registra le iterazioni in stats
+  bool timed = false;
+  for (int k = 0; k < cc->num; k++) {
+    grafo c = component_view(cc, k);
+    if (c.N < COMP_POOL_NODES)
+      continue;
+    int it;
+    bool timing = !timed && c.N == cc->largest;
+    double *r = pagerank_run(&c, &p, tpool, &it, timing ? stats : NULL);
+    timed = timed || timing;
+    memcpy(y + cc->off[k], r, c.N * sizeof(double));
+    free(r);
+    if (it > *numiter)
+      *numiter = it;
+  }
+
+  // Da sola la componente k vale y = gamma * Z, con Z = (I - d P)^-1 * 1 e
+  // gamma = ((1 - d) * somma + d * dead-end) / nodi; nel grafo intero vale
+  // c * Z, con c fissato dalla somma totale 1. Gli isolati hanno Z = 1
+  double total = params->isolated;
+  for (int k = 0; k < cc->num; k++) {
+    double sum = 0;
+    double S = 0;
+    for (int i = cc->off[k]; i < cc->off[k + 1]; i++) {
+      sum += y[i];
+      if (!h->out[i])
+        S += y[i];
+    }
+    double gamma = ((1 - d) * sum + d * S) / (cc->off[k + 1] - cc->off[k]);
+    for (int i = cc->off[k]; i < cc->off[k + 1]; i++) {
+      y[i] /= gamma;
+      total += y[i];
+    }
+  }
+
+  double c = 1 / total;
+  for (int v = 0; v < N; v++)
+    X[v] = c * y[cc->pos[v]];
+  if (params->isolated > 0)
+    X[N] = c;
+
+  free(y);
+  free(jobs);
+  return X;
+}
+
+void components_free(components_t *cc) {
+  if (cc == NULL)
+    return;
+  free_grafo(cc->h);
+  free(cc->off);
+  free(cc->pos);
+  free(cc);
+}
@@ -0,0 +1,40 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "graph.h"
+#include "pagerank.h"
+#include "stats.h"
+#include "threadpool.h"
+
+// Calcolo per componenti debolmente connesse. Teletrasporto e massa dei
+// dead-end arrivano uguali a tutti i nodi, quindi il rank di una componente
+// è proporzionale al PageRank della componente presa da sola: ognuna viene
+// risolta per conto suo, fermandosi appena converge, e i fattori di scala si
+// ricavano alla fine dalla sola massa dei dead-end di ogni componente.
+
+typedef struct {
+  int num;  // Componenti, in ordine di id minimo
+  int *off; // Nodi di h della componente k: [off[k], off[k + 1])
+  int *pos; // Posizione in h di ogni nodo di g
+  grafo *h; // g rinumerato per componenti (stesso ordine dentro ognuna);
+            // in_idx è relativo all'inizio della componente
+  int largest; // Nodi della componente più grande
+} components_t;
+
+// Trova le componenti con union-find concorrente sulle liste entranti, a
+// lavori sul thread pool. NULL se manca memoria
+components_t *components_find(const grafo *g, thread_pool_t *tpool);
+
+// Risolve le componenti: quelle grandi una alla volta con tutto il thread
+// pool, le piccole a gruppi, ognuno su un solo worker. params->isolated vale
+// come per pagerank_run, stable_k e reduced non sono supportati. numiter
+// riceve le iterazioni della componente più lenta. Ritorna i rank negli id
+// di g (g->N elementi, + 1 con nodi isolati) allocati con malloc
+double *pagerank_components(const components_t *cc,
+                            const pagerank_params_t *params,
+                            thread_pool_t *tpool, int *numiter,
+                            stats_t *stats);
+
+void components_free(components_t *cc);
+
+#endif // COMPONENTS_H
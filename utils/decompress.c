@@ -0,0 +1,462 @@
+#define _GNU_SOURCE
+#include "decompress.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define DECOMPRESS_CHUNK (256 * 1024)
+
+// La pipe più grande riduce i cambi di contesto tra decompressione e parsing
+#define DECOMPRESS_PIPE_SIZE (1 << 20)
+
+// Frame più grandi vengono decompressi in streaming: in parallelo ogni frame
+// deve stare in memoria per intero
+#define ZSTD_PARALLEL_MAX_FRAME (16 << 20)
+
+typedef enum { FORMAT_GZIP, FORMAT_ZSTD } format_t;
+
+struct decompressor {
+  format_t format;
+  FILE *src;
+  unsigned char prefix[4]; // Byte della firma già letti da src
+  size_t prefix_len;
+  int threads;
+
+  // File zstd mappato per la decompressione parallela, NULL altrimenti
+  const unsigned char *map;
+  size_t map_size;
+  void *map_base; // Mappatura allineata alla pagina, per munmap
+  size_t map_len;
+
+  int fd; // Capo di scrittura della pipe, del thread
+  FILE *out;
+  pthread_t thread;
+  int error; // Primo errno del thread, riportato da decompress_close
+};
+
+// Strumenti dei decompressori, assenti se non ne è compilato nessuno
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+
+// Il thread non termina il processo: registra l'errore e smette di
+// scrivere, il loader vede la fine dello stream e decompress_close fallisce
+static void fail(decompressor_t *d, int err) {
+  if (d->error == 0)
+    d->error = err;
+}
+
+// Scrive tutto nella pipe, false se il loader l'ha già chiusa o in caso di
+// errore
+static bool write_all(decompressor_t *d, const void *buf, size_t len) {
+  const char *p = (const char *)buf;
+  while (len > 0) {
+    ssize_t w = write(d->fd, p, len);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EPIPE)
+        fail(d, errno);
+      return false;
+    }
+    p += w;
+    len -= w;
+  }
+  return true;
+}
+
+// Legge prima i byte della firma, poi il resto di src (len >= 4)
+static size_t read_src(decompressor_t *d, unsigned char *buf, size_t len) {
+  size_t n = d->prefix_len;
+  memcpy(buf, d->prefix, n);
+  d->prefix_len = 0;
+
+  n += fread(buf + n, 1, len - n, d->src);
+  if (ferror(d->src)) {
+    fail(d, EIO);
+    return 0;
+  }
+  return n;
+}
+#endif // HAVE_ZLIB || HAVE_ZSTD
+
+#ifdef HAVE_ZLIB
+// Streaming con zlib, anche con più membri gzip concatenati
+static void run_gzip(decompressor_t *d) {
+  unsigned char *in = (unsigned char *)malloc(DECOMPRESS_CHUNK);
+  unsigned char *out = (unsigned char *)malloc(DECOMPRESS_CHUNK);
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (in == NULL || out == NULL || inflateInit2(&zs, 15 + 32) != Z_OK) {
+    fail(d, ENOMEM);
+    free(in);
+    free(out);
+    return;
+  }
+
+  bool member_end = false;
+  while (true) {
+    if (zs.avail_in == 0) {
+      zs.next_in = in;
+      zs.avail_in = read_src(d, in, DECOMPRESS_CHUNK);
+      if (zs.avail_in == 0) {
+        if (!member_end)
+          fail(d, EINVAL); // Input troncato
+        break;
+      }
+    }
+    if (member_end) {
+      inflateReset(&zs);
+      member_end = false;
+    }
+
+    zs.next_out = out;
+    zs.avail_out = DECOMPRESS_CHUNK;
+    int ret = inflate(&zs, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      fail(d, EINVAL);
+      break;
+    }
+    if (!write_all(d, out, DECOMPRESS_CHUNK - zs.avail_out))
+      break;
+    member_end = ret == Z_STREAM_END;
+  }
+
+  inflateEnd(&zs);
+  free(in);
+  free(out);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+// Streaming con un solo contesto: vale per qualsiasi numero di frame
+static void run_zstd_stream(decompressor_t *d) {
+  size_t in_cap = ZSTD_DStreamInSize();
+  size_t out_cap = ZSTD_DStreamOutSize();
+  unsigned char *in = (unsigned char *)malloc(in_cap);
+  unsigned char *out = (unsigned char *)malloc(out_cap);
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  if (in == NULL || out == NULL || dctx == NULL) {
+    fail(d, ENOMEM);
+    ZSTD_freeDCtx(dctx);
+    free(in);
+    free(out);
+    return;
+  }
+
+  size_t last = 0;
+  size_t n;
+  bool open = true;
+  while (open && (n = read_src(d, in, in_cap)) > 0) {
+    ZSTD_inBuffer input = {in, n, 0};
+    ZSTD_outBuffer output;
+    do {
+      output = (ZSTD_outBuffer){out, out_cap, 0};
+      last = ZSTD_decompressStream(dctx, &output, &input);
+      if (ZSTD_isError(last))
+        fail(d, EINVAL);
+      if (d->error != 0 || !write_all(d, out, output.pos)) {
+        open = false;
+        break;
+      }
+    } while (input.pos < input.size || output.pos == output.size);
+  }
+  if (open && last != 0)
+    fail(d, EINVAL); // Input troncato
+
+  ZSTD_freeDCtx(dctx);
+  free(in);
+  free(out);
+}
+
+// Un frame decompresso da un lavoro del thread pool
+typedef struct {
+  const unsigned char *src;
+  size_t src_size;
+  unsigned char *dst;
+  size_t dst_size;
+  bool error;
+} frame_job_t;
+
+static void frame_job(void *arg) {
+  frame_job_t *j = (frame_job_t *)arg;
+  unsigned long long size = ZSTD_getFrameContentSize(j->src, j->src_size);
+
+  if (size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR) {
+    j->dst = (unsigned char *)malloc(size > 0 ? size : 1);
+    size_t r = j->dst == NULL
+                   ? 0
+                   : ZSTD_decompress(j->dst, size, j->src, j->src_size);
+    j->error = j->dst == NULL || ZSTD_isError(r) || r != size;
+    j->dst_size = size;
+    return;
+  }
+
+  // Dimensione non scritta nel frame: buffer che cresce
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  size_t cap = j->src_size * 4 + 4096;
+  j->dst = (unsigned char *)malloc(cap);
+  j->dst_size = 0;
+  j->error = dctx == NULL || j->dst == NULL;
+
+  ZSTD_inBuffer in = {j->src, j->src_size, 0};
+  size_t r = 1;
+  while (!j->error && r != 0) {
+    if (j->dst_size == cap) {
+      cap *= 2;
+      unsigned char *grown = (unsigned char *)realloc(j->dst, cap);
+      if (grown == NULL) {
+        j->error = true;
+        break;
+      }
+      j->dst = grown;
+    }
+    ZSTD_outBuffer out = {j->dst + j->dst_size, cap - j->dst_size, 0};
+    r = ZSTD_decompressStream(dctx, &out, &in);
+    j->dst_size += out.pos;
+    if (ZSTD_isError(r) || (r != 0 && in.pos == in.size && out.pos < out.size))
+      j->error = true;
+  }
+  ZSTD_freeDCtx(dctx);
+}
+
+// Divide il file mappato nei frame a partire da *pos e ne accoda fino a max
+static int submit_frames(decompressor_t *d, thread_pool_t *tpool,
+                         frame_job_t *jobs, int max, size_t *pos) {
+  int n = 0;
+  while (n < max && *pos < d->map_size) {
+    size_t fsize =
+        ZSTD_findFrameCompressedSize(d->map + *pos, d->map_size - *pos);
+    if (ZSTD_isError(fsize)) {
+      fail(d, EINVAL);
+      *pos = d->map_size;
+      break;
+    }
+    jobs[n] = (frame_job_t){.src = d->map + *pos, .src_size = fsize};
+    tp_add_work(tpool, frame_job, &jobs[n]);
+    *pos += fsize;
+    n++;
+  }
+  return n;
+}
+
+// Frame in parallelo a gruppi: mentre un gruppo viene scritto nella pipe il
+// successivo è già in decompressione
+static void run_zstd_frames(decompressor_t *d) {
+  thread_pool_t *tpool = tp_create(d->threads);
+  int batch = d->threads * 2;
+  frame_job_t *jobs[2];
+  jobs[0] = (frame_job_t *)calloc(batch, sizeof(frame_job_t));
+  jobs[1] = (frame_job_t *)calloc(batch, sizeof(frame_job_t));
+  if (tpool == NULL || jobs[0] == NULL || jobs[1] == NULL) {
+    fail(d, ENOMEM);
+    free(jobs[0]);
+    free(jobs[1]);
+    tp_destroy(tpool);
+    return;
+  }
+
+  size_t pos = 0;
+  int cur = 0;
+  int n = submit_frames(d, tpool, jobs[cur], batch, &pos);
+  tp_wait(tpool);
+
+  bool open = true;
+  while (n > 0) {
+    int next_n = open ? submit_frames(d, tpool, jobs[1 - cur], batch, &pos) : 0;
+
+    for (int i = 0; i < n; i++) {
+      if (jobs[cur][i].error) {
+        fail(d, EINVAL);
+        open = false;
+      }
+      if (open)
+        open = write_all(d, jobs[cur][i].dst, jobs[cur][i].dst_size);
+      free(jobs[cur][i].dst);
+    }
+
+    tp_wait(tpool);
+    cur = 1 - cur;
+    n = next_n;
+  }
+
+  free(jobs[0]);
+  free(jobs[1]);
+  tp_destroy(tpool);
+}
+
+// Con più thread e un file regolare con più frame piccoli conviene la
+// decompressione parallela; altrimenti streaming
+static void map_frames(decompressor_t *d) {
+  if (d->threads < 2)
+    return;
+
+  int fd = fileno(d->src);
+  struct stat st;
+  off_t start = ftello(d->src);
+  if (fd < 0 || start < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return;
+  start -= d->prefix_len;
+
+  // mmap vuole un offset allineato alla pagina
+  off_t page = sysconf(_SC_PAGESIZE);
+  off_t base = start / page * page;
+  size_t len = st.st_size - base;
+  unsigned char *map =
+      (unsigned char *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, base);
+  if (map == MAP_FAILED)
+    return;
+
+  const unsigned char *data = map + (start - base);
+  size_t size = st.st_size - start;
+  size_t first = ZSTD_findFrameCompressedSize(data, size);
+  if (ZSTD_isError(first) || first == size ||
+      first > ZSTD_PARALLEL_MAX_FRAME) {
+    munmap(map, len);
+    return;
+  }
+
+  madvise(map, len, MADV_SEQUENTIAL);
+  d->map = data;
+  d->map_size = size;
+  d->map_base = map;
+  d->map_len = len;
+}
+#endif
+
+static void *decompress_thread(void *arg) {
+  decompressor_t *d = (decompressor_t *)arg;
+
+  // Se il loader chiude la pipe prima della fine la write ritorna EPIPE
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  switch (d->format) {
+  case FORMAT_GZIP:
+#ifdef HAVE_ZLIB
+    run_gzip(d);
+#endif
+    break;
+  case FORMAT_ZSTD:
+#ifdef HAVE_ZSTD
+    if (d->map != NULL)
+      run_zstd_frames(d);
+    else
+      run_zstd_stream(d);
+#endif
+    break;
+  }
+
+  close(d->fd);
+  return NULL;
+}
+
+static decompressor_t *open_failed(decompressor_t *d, FILE **out, int err) {
+  if (d->map_base != NULL)
+    munmap(d->map_base, d->map_len);
+  free(d);
+  *out = NULL;
+  errno = err;
+  return NULL;
+}
+
+decompressor_t *decompress_open(FILE *file, int threads, FILE **out) {
+  *out = file;
+
+  int c = fgetc(file);
+  if (c == EOF)
+    return NULL;
+  if (c != 0x1f && c != 0x28) {
+    ungetc(c, file);
+    return NULL;
+  }
+
+  decompressor_t *d = (decompressor_t *)calloc(1, sizeof(decompressor_t));
+  if (d == NULL) {
+    *out = NULL;
+    return NULL;
+  }
+  d->src = file;
+  d->threads = threads;
+  d->prefix[0] = (unsigned char)c;
+  d->prefix_len = 1;
+
+  size_t magic_len = c == 0x1f ? 2 : 4;
+  d->prefix_len += fread(d->prefix + 1, 1, magic_len - 1, file);
+  if (d->prefix_len == 2 && memcmp(d->prefix, "\x1f\x8b", 2) == 0) {
+    d->format = FORMAT_GZIP;
+  } else if (d->prefix_len == 4 &&
+             memcmp(d->prefix, "\x28\xb5\x2f\xfd", 4) == 0) {
+    d->format = FORMAT_ZSTD;
+  } else {
+    return open_failed(d, out, EINVAL); // Firma non riconosciuta
+  }
+
+#ifndef HAVE_ZLIB
+  if (d->format == FORMAT_GZIP)
+    return open_failed(d, out, ENOTSUP);
+#endif
+#ifndef HAVE_ZSTD
+  if (d->format == FORMAT_ZSTD)
+    return open_failed(d, out, ENOTSUP);
+#else
+  if (d->format == FORMAT_ZSTD)
+    map_frames(d);
+#endif
+
+  int fds[2];
+  if (pipe(fds) != 0)
+    return open_failed(d, out, errno);
+  fcntl(fds[1], F_SETPIPE_SZ, DECOMPRESS_PIPE_SIZE);
+  d->fd = fds[1];
+  d->out = fdopen(fds[0], "r");
+  if (d->out == NULL) {
+    int err = errno;
+    close(fds[0]);
+    close(fds[1]);
+    return open_failed(d, out, err);
+  }
+
+  int err = pthread_create(&d->thread, NULL, decompress_thread, d);
+  if (err != 0) {
+    fclose(d->out);
+    close(d->fd);
+    return open_failed(d, out, err);
+  }
+
+  *out = d->out;
+  return d;
+}
+
+int decompress_close(decompressor_t *d) {
+  if (d == NULL)
+    return 0;
+
+  fclose(d->out);
+  pthread_join(d->thread, NULL);
+  if (d->map_base != NULL)
+    munmap(d->map_base, d->map_len);
+  int err = d->error;
+  free(d);
+
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
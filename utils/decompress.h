@@ -0,0 +1,35 @@
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+
+#include <stdio.h>
+
+// Decompressione trasparente dell'input. Se lo stream inizia con la firma
+// gzip (1f 8b) o zstd (28 b5 2f fd) un thread separato lo decomprime in una
+// pipe, da cui il loader legge come da un file normale: decompressione,
+// parsing e costruzione del grafo procedono insieme, senza file temporanei.
+//
+// Un file zstd regolare con più frame (ad esempio scritto da pzstd o da più
+// file .zst concatenati) viene mappato in memoria e i frame vengono
+// decompressi in parallelo su un thread pool, poi scritti in ordine.
+//
+// Il supporto dipende dalla compilazione: HAVE_ZLIB per gzip, HAVE_ZSTD per
+// zstd (vedi Makefile). Nessun errore termina il processo: un input compresso
+// non supportato fa fallire decompress_open, dati corrotti o troncati fanno
+// fallire decompress_close.
+
+typedef struct decompressor decompressor_t;
+
+// Controlla la firma di file. Se è compresso avvia la decompressione,
+// assegna a *out lo stream dei dati decompressi e ritorna il decompressore;
+// altrimenti *out = file e ritorna NULL. threads è il numero di thread per i
+// frame zstd. Va chiamata prima di qualsiasi altra lettura da file. In caso
+// di errore ritorna NULL con *out = NULL ed errno impostato (ENOTSUP per un
+// formato non compilato)
+decompressor_t *decompress_open(FILE *file, int threads, FILE **out);
+
+// Chiude lo stream decompresso e attende il thread. file resta aperto.
+// Ritorna -1 con errno impostato se i dati compressi erano corrotti o
+// troncati: in quel caso lo stream letto è incompleto
+int decompress_close(decompressor_t *d);
+
+#endif // DECOMPRESS_H
@@ -1,7 +1,9 @@
 #include "graph.h"
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 edges_array_t *create_edges_array() {
   // Allocate memory for the edges_array structure
@@ -42,24 +44,25 @@ void destroy_edges_array(edges_array_t *edges) {
   free(edges);
 }
 
-void insert_edges_array(edges_array_t *edges, int data, outgoing_edges_t *out) {
+static int insert_edges_array(edges_array_t *edges, int data,
+                              outgoing_edges_t *out) {
   pthread_mutex_lock(&(edges->mutex));
 
-  if (edges->edges_num == edges->size) {
-    edges->size *= 2;
-    edges->array = (int *)realloc(edges->array, edges->size * sizeof(int));
-    if (edges->array == NULL) {
-      fprintf(stderr, "Failed to reallocate memory for array.\n");
+  for (long i = 0; i < edges->edges_num; i++) {
+    if (edges->array[i] == data) {
       pthread_mutex_unlock(&(edges->mutex));
-      return;
+      return 0;
     }
   }
 
-  for (int i = 0; i < edges->edges_num; i++) {
-    if (edges->array[i] == data) {
+  if (edges->edges_num == edges->size) {
+    int *array = (int *)realloc(edges->array, 2 * edges->size * sizeof(int));
+    if (array == NULL) {
       pthread_mutex_unlock(&(edges->mutex));
-      return;
+      return -1;
     }
+    edges->array = array;
+    edges->size *= 2;
   }
 
   edges->array[edges->edges_num] = data;
@@ -69,6 +72,7 @@ void insert_edges_array(edges_array_t *edges, int data, outgoing_edges_t *out) {
   pthread_mutex_unlock(&(edges->mutex));
 
   insert_outgoing_edges(out, data);
+  return 0;
 }
 
 outgoing_edges_t *create_outgoing_edges(int size) {
@@ -76,21 +80,22 @@ outgoing_edges_t *create_outgoing_edges(int size) {
       (outgoing_edges_t *)calloc(1, sizeof(outgoing_edges_t));
 
   if (out == NULL) {
-    perror("Errore di allocazione array g->out.");
-    exit(EXIT_FAILURE);
+    return NULL;
   }
 
-  if (pthread_mutex_init(&(out->mutex), NULL) != 0) {
-    perror("Errore inizializzazione mutex.");
+  int err = pthread_mutex_init(&(out->mutex), NULL);
+  if (err != 0) {
     free(out);
-    exit(EXIT_FAILURE);
+    errno = err;
+    return NULL;
   }
 
-  out->outgoing_edges = (int *)calloc(size, sizeof(int));
+  out->outgoing_edges = (int *)calloc(size > 0 ? size : 1, sizeof(int));
 
   if (out->outgoing_edges == NULL) {
-    perror("Errore di allocazione array g->out.");
-    exit(EXIT_FAILURE);
+    pthread_mutex_destroy(&(out->mutex));
+    free(out);
+    return NULL;
   }
 
   return out;
@@ -108,16 +113,15 @@ void insert_outgoing_edges(outgoing_edges_t *out, int node) {
 inmap *create_inmap(int size) {
   inmap *map = (inmap *)calloc(1, sizeof(inmap));
   if (map == NULL) {
-    perror("Errore allocazione memoria mappa.");
-    exit(EXIT_FAILURE);
+    return NULL;
   }
   map->size = size;
 
-  map->edges_array = (edges_array_t **)calloc(size, sizeof(edges_array_t *));
+  map->edges_array =
+      (edges_array_t **)calloc(size > 0 ? size : 1, sizeof(edges_array_t *));
   if (map->edges_array == NULL) {
-    perror("Errore allocazione memoria edges array.");
     free(map);
-    exit(EXIT_FAILURE);
+    return NULL;
   }
 
   for (int i = 0; i < size; i++) {
@@ -128,19 +132,21 @@ inmap *create_inmap(int size) {
       }
       free(map->edges_array);
       free(map);
-      exit(EXIT_FAILURE);
+      errno = ENOMEM;
+      return NULL;
     }
   }
   return map;
 }
 
-void insert_inmap(inmap *map, int entering, int exiting,
-                  outgoing_edges_t *out) {
+int insert_inmap(inmap *map, int entering, int exiting,
+                 outgoing_edges_t *out) {
   if (exiting >= 0 && exiting < map->size && entering != exiting &&
       entering >= 0 && entering < map->size) {
     // printf("Inserted node %d in array_node %d\n", entering, exiting);
-    insert_edges_array(map->edges_array[(exiting)], entering, out);
+    return insert_edges_array(map->edges_array[(exiting)], entering, out);
   }
+  return 0;
 }
 
 // Funzione per deallocare la memoria occupata dall'inmap
@@ -160,3 +166,159 @@ void free_outgoing_edges(outgoing_edges_t *out) {
   pthread_mutex_destroy(&(out->mutex));
   free(out);
 }
+
+// NULL se manca memoria
+static grafo *alloc_grafo(int N, long edges) {
+  grafo *g = (grafo *)calloc(1, sizeof(grafo));
+  if (g == NULL) {
+    return NULL;
+  }
+
+  g->N = N;
+  g->in_off = (long *)calloc(N + 1, sizeof(long));
+  g->in_idx = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+  if (g->in_off == NULL || g->in_idx == NULL) {
+    free_grafo(g);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  return g;
+}
+
+grafo *grafo_from_inmap(inmap *map, int *out) {
+  long edges = 0;
+  for (int i = 0; i < map->size; i++) {
+    edges += map->edges_array[i]->edges_num;
+  }
+
+  grafo *g = alloc_grafo(map->size, edges);
+  if (g == NULL) {
+    free_inmap(map);
+    free(out);
+    errno = ENOMEM;
+    return NULL;
+  }
+  g->out = out;
+
+  long pos = 0;
+  for (int i = 0; i < map->size; i++) {
+    edges_array_t *e = map->edges_array[i];
+    g->in_off[i] = pos;
+    memcpy(&g->in_idx[pos], e->array, e->edges_num * sizeof(int));
+    pos += e->edges_num;
+  }
+  g->in_off[map->size] = pos;
+
+  free_inmap(map);
+  return g;
+}
+
+static int cmp_int(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+grafo *grafo_from_edges(int N, const int *src, const int *dst, long edges) {
+  // Primo passaggio: conteggio degli archi entranti per nodo
+  long *count = (long *)calloc(N + 1, sizeof(long));
+  if (count == NULL) {
+    return NULL;
+  }
+
+  long valid = 0;
+  for (long i = 0; i < edges; i++) {
+    if (src[i] >= 0 && src[i] < N && dst[i] >= 0 && dst[i] < N &&
+        src[i] != dst[i]) {
+      count[dst[i] + 1]++;
+      valid++;
+    }
+  }
+
+  grafo *g = alloc_grafo(N, valid);
+  if (g != NULL) {
+    g->out = (int *)calloc(N > 0 ? N : 1, sizeof(int));
+  }
+  if (g == NULL || g->out == NULL) {
+    free_grafo(g);
+    free(count);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  for (int i = 0; i < N; i++) {
+    count[i + 1] += count[i];
+  }
+
+  // Secondo passaggio: distribuzione delle sorgenti (count fa da cursore)
+  for (long i = 0; i < edges; i++) {
+    if (src[i] >= 0 && src[i] < N && dst[i] >= 0 && dst[i] < N &&
+        src[i] != dst[i]) {
+      g->in_idx[count[dst[i]]++] = src[i];
+    }
+  }
+
+  // Ordina ogni lista ed elimina i duplicati compattando in place
+  long pos = 0;
+  long begin = 0;
+  for (int j = 0; j < N; j++) {
+    long end = count[j];
+    qsort(&g->in_idx[begin], end - begin, sizeof(int), cmp_int);
+
+    g->in_off[j] = pos;
+    for (long k = begin; k < end; k++) {
+      if (k > begin && g->in_idx[k] == g->in_idx[k - 1])
+        continue;
+      g->in_idx[pos++] = g->in_idx[k];
+      g->out[g->in_idx[k]]++;
+    }
+    begin = end;
+  }
+  g->in_off[N] = pos;
+
+  free(count);
+  return g;
+}
+
+long grafo_arcs(const grafo *g) { return g->in_off[g->N]; }
+
+int grafo_out_lists(const grafo *g, long **out_off, int **out_idx) {
+  int N = g->N;
+  long arcs = grafo_arcs(g);
+  long *off = (long *)calloc((size_t)N + 1, sizeof(long));
+  int *idx = (int *)malloc((arcs > 0 ? arcs : 1) * sizeof(int));
+  if (off == NULL || idx == NULL) {
+    free(off);
+    free(idx);
+    return -1;
+  }
+
+  // Gradi dalle liste stesse, non da g->out: le posizioni devono tornare
+  for (long k = 0; k < arcs; k++)
+    off[g->in_idx[k] + 1]++;
+  for (int i = 0; i < N; i++)
+    off[i + 1] += off[i];
+
+  // off fa da cursore e finisce spostato di un nodo
+  for (int j = 0; j < N; j++) {
+    for (long k = g->in_off[j]; k < g->in_off[j + 1]; k++)
+      idx[off[g->in_idx[k]]++] = j;
+  }
+  memmove(off + 1, off, (size_t)N * sizeof(long));
+  off[0] = 0;
+
+  *out_off = off;
+  *out_idx = idx;
+  return 0;
+}
+
+void free_grafo(grafo *g) {
+  if (g == NULL) {
+    return;
+  }
+  free(g->out);
+  free(g->in_off);
+  free(g->in_idx);
+  free(g);
+}
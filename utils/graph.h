@@ -5,8 +5,8 @@
 typedef struct edges_array {
   int *array;
   pthread_mutex_t mutex;
-  int size;
-  int edges_num;
+  long size;
+  long edges_num;
 } edges_array_t;
 
 typedef struct {
@@ -20,12 +20,21 @@ typedef struct {
   int size;
 } inmap;
 
+// Grafo finale in formato CSR: gli archi entranti nel nodo j sono
+// in_idx[in_off[j]] ... in_idx[in_off[j + 1] - 1].
+// Gli offset sono a 64 bit, così il grafo può avere più di 2^31 archi; gli id
+// dei nodi e i gradi restano int (N < 2^31, e un grado non supera N - 1),
+// quindi in_idx, l'array più grande, non raddoppia
 typedef struct {
   int N;
-  int *out;
-  inmap *in;
+  int *out;     // Grado uscente di ogni nodo
+  long *in_off; // N + 1 offset in in_idx
+  int *in_idx;  // Nodi di origine degli archi entranti
 } grafo;
 
+// Le funzioni che allocano ritornano NULL se manca memoria, con errno
+// impostato: il loader è usato anche da libpagerank e non termina il processo
+
 // Funzione per inizializzare una linked list
 outgoing_edges_t *create_outgoing_edges(int size);
 
@@ -40,11 +49,31 @@ void free_outgoing_edges(outgoing_edges_t *out);
 inmap *create_inmap(int size);
 void print_inmap(inmap *map);
 
-void insert_inmap(inmap *map, int entering, int exiting, outgoing_edges_t *out);
+// Ritorna 0 o -1 se manca memoria (l'arco non viene inserito)
+int insert_inmap(inmap *map, int entering, int exiting, outgoing_edges_t *out);
 
 // Funzione per deallocare la memoria occupata dall'inmap
 void free_inmap(inmap *map);
 
 void free_outgoing_edges(outgoing_edges_t *out);
 
+// Compatta l'inmap nel grafo CSR e la libera. Il grafo prende possesso
+// dell'array dei gradi uscenti out, liberato anche in caso di errore
+grafo *grafo_from_inmap(inmap *map, int *out);
+
+// Costruisce il grafo CSR da array di archi src[i] -> dst[i] con id 0-based.
+// Come nel loader vengono scartati self-loop, duplicati e archi fuori range
+grafo *grafo_from_edges(int N, const int *src, const int *dst, long edges);
+
+// Numero di archi validi del grafo
+long grafo_arcs(const grafo *g);
+
+// Liste degli archi uscenti in CSR, trasposte da quelle entranti: i
+// successori di i sono (*out_idx)[(*out_off)[i]] ... con N + 1 offset,
+// ognuna in ordine crescente. Ritorna 0 o -1 se manca memoria
+int grafo_out_lists(const grafo *g, long **out_off, int **out_idx);
+
+// Libera il grafo con tutti i suoi array
+void free_grafo(grafo *g);
+
 #endif
@@ -0,0 +1,190 @@
+#include "graph_shm.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// shm_open vuole un nome che inizia con '/'
+static char *shm_path(const char *name) {
+  size_t len = strlen(name);
+  char *path = (char *)malloc(len + 2);
+  if (path == NULL)
+    return NULL;
+  if (name[0] == '/') {
+    memcpy(path, name, len + 1);
+  } else {
+    path[0] = '/';
+    memcpy(path + 1, name, len + 1);
+  }
+  return path;
+}
+
+static size_t page_round(size_t n) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  return (n + page - 1) / page * page;
+}
+
+// Posizione di in_off e in_idx dall'inizio dei dati
+static size_t off_pos(int N) {
+  return ((size_t)N * sizeof(int) + sizeof(long) - 1) / sizeof(long) *
+         sizeof(long);
+}
+
+static size_t idx_pos(int N) {
+  return off_pos(N) + ((size_t)N + 1) * sizeof(long);
+}
+
+int graph_shm_publish(const grafo *g, const char *name) {
+  char *path = shm_path(name);
+  if (path == NULL)
+    return -1;
+
+  long arcs = grafo_arcs(g);
+  size_t header_size = page_round(sizeof(graph_shm_header_t));
+  size_t data_size = idx_pos(g->N) + (size_t)arcs * sizeof(int);
+  size_t size = header_size + data_size;
+
+  int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    free(path);
+    return -1;
+  }
+
+  void *map = MAP_FAILED;
+  if (ftruncate(fd, (off_t)size) == 0)
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  int saved = errno;
+  close(fd);
+  if (map == MAP_FAILED) {
+    shm_unlink(path);
+    free(path);
+    errno = saved;
+    return -1;
+  }
+
+  graph_shm_header_t *h = (graph_shm_header_t *)map;
+  memcpy(h->magic, GRAPH_SHM_MAGIC, 4);
+  h->version = GRAPH_SHM_VERSION;
+  h->N = g->N;
+  h->arcs = arcs;
+  h->data_offset = header_size;
+  h->size = size;
+  atomic_store(&h->attached, 0);
+
+  char *data = (char *)map + header_size;
+  memcpy(data, g->out, g->N * sizeof(int));
+  memcpy(data + off_pos(g->N), g->in_off, (g->N + 1) * sizeof(long));
+  memcpy(data + idx_pos(g->N), g->in_idx, arcs * sizeof(int));
+
+  // I processi che trovano ready a 1 vedono anche tutto il contenuto
+  atomic_store_explicit(&h->ready, 1, memory_order_release);
+
+  munmap(map, size);
+  free(path);
+  return 0;
+}
+
+graph_shm_t *graph_shm_attach(const char *name) {
+  char *path = shm_path(name);
+  if (path == NULL)
+    return NULL;
+
+  int fd = shm_open(path, O_RDWR, 0);
+  free(path);
+  if (fd < 0)
+    return NULL;
+
+  graph_shm_t *shm = (graph_shm_t *)calloc(1, sizeof(graph_shm_t));
+  struct stat st;
+  if (shm == NULL || fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(graph_shm_header_t)) {
+    close(fd);
+    free(shm);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  // Solo l'intestazione è scrivibile, gli array del grafo no
+  shm->header_size = page_round(sizeof(graph_shm_header_t));
+  shm->header = (graph_shm_header_t *)mmap(NULL, shm->header_size,
+                                           PROT_READ | PROT_WRITE, MAP_SHARED,
+                                           fd, 0);
+  if (shm->header == MAP_FAILED) {
+    close(fd);
+    free(shm);
+    return NULL;
+  }
+
+  graph_shm_header_t *h = shm->header;
+  if (memcmp(h->magic, GRAPH_SHM_MAGIC, 4) != 0 ||
+      h->version != GRAPH_SHM_VERSION ||
+      atomic_load_explicit(&h->ready, memory_order_acquire) != 1 ||
+      h->data_offset != shm->header_size || h->size != (uint64_t)st.st_size ||
+      h->N < 0 ||
+      h->size - h->data_offset != idx_pos(h->N) + h->arcs * sizeof(int)) {
+    munmap(h, shm->header_size);
+    close(fd);
+    free(shm);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  shm->data_size = h->size - h->data_offset;
+  shm->data = mmap(NULL, shm->data_size, PROT_READ, MAP_SHARED, fd,
+                   (off_t)h->data_offset);
+  close(fd);
+  if (shm->data == MAP_FAILED) {
+    munmap(h, shm->header_size);
+    free(shm);
+    return NULL;
+  }
+
+  char *data = (char *)shm->data;
+  shm->g.N = h->N;
+  shm->g.out = (int *)data;
+  shm->g.in_off = (long *)(data + off_pos(h->N));
+  shm->g.in_idx = (int *)(data + idx_pos(h->N));
+
+  atomic_fetch_add(&h->attached, 1);
+  return shm;
+}
+
+void graph_shm_detach(graph_shm_t *shm) {
+  if (shm == NULL)
+    return;
+
+  atomic_fetch_sub(&shm->header->attached, 1);
+  munmap(shm->data, shm->data_size);
+  munmap(shm->header, shm->header_size);
+  free(shm);
+}
+
+int graph_shm_unlink(const char *name, int *attached) {
+  char *path = shm_path(name);
+  if (path == NULL)
+    return -1;
+
+  if (attached != NULL) {
+    *attached = 0;
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd >= 0) {
+      graph_shm_header_t *h = (graph_shm_header_t *)mmap(
+          NULL, sizeof(graph_shm_header_t), PROT_READ, MAP_SHARED, fd, 0);
+      if (h != MAP_FAILED) {
+        if (memcmp(h->magic, GRAPH_SHM_MAGIC, 4) == 0)
+          *attached = atomic_load(&h->attached);
+        munmap(h, sizeof(graph_shm_header_t));
+      }
+      close(fd);
+    }
+  }
+
+  int ret = shm_unlink(path);
+  free(path);
+  return ret;
+}
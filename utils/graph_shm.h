@@ -0,0 +1,57 @@
+#ifndef GRAPH_SHM_H
+#define GRAPH_SHM_H
+
+#include "graph.h"
+#include <stdint.h>
+
+// Grafo CSR pubblicato in un segmento di memoria condivisa POSIX con nome,
+// così più processi pagerank usano la stessa copia senza ricaricarla.
+//
+// Il segmento contiene un'intestazione su una pagina propria, scrivibile
+// (contatore dei processi collegati), seguita dagli array out (int),
+// in_off (long, allineato a 8 byte) e in_idx (int), che i processi collegati
+// mappano in sola lettura.
+
+#define GRAPH_SHM_MAGIC "PRSG"
+#define GRAPH_SHM_VERSION 2
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  int32_t N;
+  uint32_t reserved;
+  int64_t arcs;
+  uint64_t data_offset; // Inizio di out, allineato alla pagina
+  uint64_t size;        // Dimensione totale del segmento
+  _Atomic int32_t attached; // Processi collegati in questo momento
+  _Atomic int32_t ready;    // 1 quando il contenuto è completo
+} graph_shm_header_t;
+
+// Grafo collegato: g punta direttamente nella memoria condivisa e non va
+// liberato con free_grafo
+typedef struct {
+  grafo g;
+  graph_shm_header_t *header;
+  size_t header_size;
+  void *data;
+  size_t data_size;
+} graph_shm_t;
+
+// Copia il grafo nel segmento name (creato, fallisce se esiste già).
+// Ritorna 0 o -1 con errno impostato
+int graph_shm_publish(const grafo *g, const char *name);
+
+// Collega il segmento name senza copiare il grafo e incrementa il contatore.
+// Ritorna NULL con errno impostato se non esiste o non è valido
+graph_shm_t *graph_shm_attach(const char *name);
+
+// Decrementa il contatore e rilascia la mappatura
+void graph_shm_detach(graph_shm_t *shm);
+
+// Rimuove il nome del segmento: nessun nuovo processo può collegarsi, la
+// memoria viene liberata dal sistema quando l'ultimo processo collegato
+// termina o si scollega. *attached (se non NULL) riceve i processi ancora
+// collegati. Ritorna 0 o -1 con errno impostato
+int graph_shm_unlink(const char *name, int *attached);
+
+#endif // GRAPH_SHM_H
@@ -0,0 +1,351 @@
+#include "libpagerank.h"
+#include "graph.h"
+#include "loader.h"
+#include "pagerank.h"
+#include "rankdump.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct pr_graph {
+  grafo *g;
+  int dead_ends;
+};
+
+struct pr_builder {
+  int nodes;
+  int *src;
+  int *dst;
+  long edges;
+  long capacity;
+};
+
+struct pr_pool {
+  thread_pool_t *tpool;
+  int threads;
+  pthread_mutex_t run_mutex; // Serializza le esecuzioni sullo stesso pool
+};
+
+void pr_params_default(pr_params_t *params) {
+  params->damping = 0.9;
+  params->eps = 1.0e-7;
+  params->maxiter = 100;
+  params->grain = 0;
+  params->width = 0;
+}
+
+pr_pool_t *pr_pool_create(int threads) {
+  if (threads <= 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pr_pool_t *pool = (pr_pool_t *)calloc(1, sizeof(pr_pool_t));
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pool->threads = threads;
+  pool->tpool = tp_create(threads);
+  pthread_mutex_init(&pool->run_mutex, NULL);
+
+  return pool;
+}
+
+int pr_pool_threads(const pr_pool_t *pool) {
+  if (pool == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return pool->threads;
+}
+
+void pr_pool_destroy(pr_pool_t *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  tp_destroy(pool->tpool);
+  pthread_mutex_destroy(&pool->run_mutex);
+  free(pool);
+}
+
+static pr_graph_t *wrap_graph(grafo *g) {
+  if (g == NULL) {
+    return NULL;
+  }
+
+  pr_graph_t *graph = (pr_graph_t *)calloc(1, sizeof(pr_graph_t));
+  if (graph == NULL) {
+    free_grafo(g);
+    return NULL;
+  }
+
+  graph->g = g;
+  for (int i = 0; i < g->N; i++) {
+    if (g->out[i] == 0)
+      graph->dead_ends++;
+  }
+
+  return graph;
+}
+
+pr_graph_t *pr_graph_from_edges(int nodes, const int *src, const int *dst,
+                                long edges) {
+  if (nodes <= 0 || edges < 0 || (edges > 0 && (src == NULL || dst == NULL))) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return wrap_graph(grafo_from_edges(nodes, src, dst, edges));
+}
+
+pr_builder_t *pr_builder_create(int nodes, long expected_edges) {
+  if (nodes <= 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pr_builder_t *builder = (pr_builder_t *)calloc(1, sizeof(pr_builder_t));
+  if (builder == NULL) {
+    return NULL;
+  }
+
+  // Il suggerimento non viene preso alla lettera: un client non deve poter
+  // far allocare memoria per archi che non invierà mai
+  long capacity = expected_edges;
+  if (capacity < 1024)
+    capacity = 1024;
+  if (capacity > (1L << 20))
+    capacity = 1L << 20;
+
+  builder->nodes = nodes;
+  builder->capacity = capacity;
+  builder->src = (int *)malloc(capacity * sizeof(int));
+  builder->dst = (int *)malloc(capacity * sizeof(int));
+  if (builder->src == NULL || builder->dst == NULL) {
+    pr_builder_free(builder);
+    return NULL;
+  }
+
+  return builder;
+}
+
+int pr_builder_add(pr_builder_t *builder, const int *src, const int *dst,
+                   long edges) {
+  if (builder == NULL || edges < 0 ||
+      (edges > 0 && (src == NULL || dst == NULL))) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (builder->edges + edges > builder->capacity) {
+    long capacity = builder->capacity;
+    while (builder->edges + edges > capacity)
+      capacity *= 2;
+
+    int *s = (int *)realloc(builder->src, capacity * sizeof(int));
+    if (s == NULL)
+      return -1;
+    builder->src = s;
+    int *d = (int *)realloc(builder->dst, capacity * sizeof(int));
+    if (d == NULL)
+      return -1;
+    builder->dst = d;
+    builder->capacity = capacity;
+  }
+
+  memcpy(&builder->src[builder->edges], src, edges * sizeof(int));
+  memcpy(&builder->dst[builder->edges], dst, edges * sizeof(int));
+  builder->edges += edges;
+
+  return 0;
+}
+
+long pr_builder_edges(const pr_builder_t *builder) {
+  if (builder == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return builder->edges;
+}
+
+pr_graph_t *pr_builder_finish(pr_builder_t *builder) {
+  if (builder == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  grafo *g = grafo_from_edges(builder->nodes, builder->src, builder->dst,
+                              builder->edges);
+  pr_builder_free(builder);
+
+  return wrap_graph(g);
+}
+
+void pr_builder_free(pr_builder_t *builder) {
+  if (builder == NULL) {
+    return;
+  }
+  free(builder->src);
+  free(builder->dst);
+  free(builder);
+}
+
+pr_graph_t *pr_graph_load(const char *filename, int threads) {
+  if (filename == NULL || threads <= 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return wrap_graph(load_graph((char *)filename, threads, NULL));
+}
+
+int pr_graph_nodes(const pr_graph_t *graph) {
+  if (graph == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return graph->g->N;
+}
+
+long pr_graph_arcs(const pr_graph_t *graph) {
+  if (graph == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return grafo_arcs(graph->g);
+}
+
+int pr_graph_dead_ends(const pr_graph_t *graph) {
+  if (graph == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return graph->dead_ends;
+}
+
+void pr_graph_free(pr_graph_t *graph) {
+  if (graph == NULL) {
+    return;
+  }
+  free_grafo(graph->g);
+  free(graph);
+}
+
+int pr_run(const pr_graph_t *graph, const pr_params_t *params, pr_pool_t *pool,
+           pr_result_t *result) {
+  pr_params_t defaults;
+  if (params == NULL) {
+    pr_params_default(&defaults);
+    params = &defaults;
+  }
+
+  if (graph == NULL || pool == NULL || result == NULL ||
+      params->damping <= 0 || params->damping >= 1 || params->maxiter <= 0 ||
+      params->grain < 0 || params->width < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pagerank_params_t p = {.d = params->damping,
+                         .eps = params->eps,
+                         .maxiter = params->maxiter,
+                         .grain = params->grain,
+                         .width = params->width};
+  int iter = 0;
+
+  // I grafi piccoli non passano dal pool: niente attese né lock
+  double *ranks;
+  const grafo *g = graph->g;
+  if (g->N + grafo_arcs(g) <= PAGERANK_SEQUENTIAL_WORK) {
+    ranks = pagerank_run(graph->g, &p, NULL, &iter, NULL);
+  } else {
+    pthread_mutex_lock(&pool->run_mutex);
+    ranks = pagerank_run(graph->g, &p, pool->tpool, &iter, NULL);
+    pthread_mutex_unlock(&pool->run_mutex);
+  }
+
+  result->nodes = graph->g->N;
+  result->ranks = ranks;
+  result->iterations = iter;
+  result->converged = iter < params->maxiter;
+
+  return 0;
+}
+
+void pr_result_free(pr_result_t *result) {
+  if (result == NULL) {
+    return;
+  }
+  free(result->ranks);
+  result->ranks = NULL;
+  result->nodes = 0;
+}
+
+int pr_top_k(const pr_result_t *result, int k, int *nodes, double *values) {
+  if (result == NULL || result->ranks == NULL || k < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int *idx = (int *)malloc((k > 0 ? k : 1) * sizeof(int));
+  if (idx == NULL) {
+    return -1;
+  }
+
+  int n = pagerank_top_k(result->ranks, result->nodes, k, idx);
+  for (int i = 0; i < n; i++) {
+    if (nodes != NULL)
+      nodes[i] = idx[i];
+    if (values != NULL)
+      values[i] = result->ranks[idx[i]];
+  }
+
+  free(idx);
+  return n;
+}
+
+int pr_write_report(FILE *f, const pr_graph_t *graph, const pr_result_t *result,
+                    const pr_params_t *params, int k) {
+  pr_params_t defaults;
+  if (params == NULL) {
+    pr_params_default(&defaults);
+    params = &defaults;
+  }
+
+  if (f == NULL || graph == NULL || result == NULL || result->ranks == NULL ||
+      k <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int *top = (int *)malloc(k * sizeof(int));
+  if (top == NULL) {
+    return -1;
+  }
+
+  pagerank_top_k(result->ranks, result->nodes, k, top);
+  pagerank_report(f, graph->g, result->ranks, result->iterations,
+                  params->maxiter, false, k, top);
+
+  free(top);
+  return 0;
+}
+
+int pr_result_write(const pr_result_t *result, const char *path,
+                    int with_order, pr_pool_t *pool) {
+  if (result == NULL || result->ranks == NULL || path == NULL ||
+      pool == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&pool->run_mutex);
+  int ret = rank_dump_write(path, result->ranks, result->nodes, with_order != 0,
+                            pool->tpool);
+  pthread_mutex_unlock(&pool->run_mutex);
+  return ret;
+}
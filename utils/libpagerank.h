@@ -0,0 +1,96 @@
+#ifndef LIBPAGERANK_H
+#define LIBPAGERANK_H
+
+// API C di libpagerank: grafo persistente, thread pool riusabile e calcolo
+// del PageRank senza passare dall'eseguibile. Gli id dei nodi sono 0-based.
+// Le funzioni che ritornano un puntatore ritornano NULL in caso di errore,
+// quelle che ritornano int ritornano -1; in entrambi i casi errno è settato.
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pr_graph pr_graph_t;
+typedef struct pr_pool pr_pool_t;
+typedef struct pr_builder pr_builder_t;
+
+typedef struct {
+  double damping; // Damping factor, in (0, 1) (default 0.9)
+  double eps;     // Errore L1 massimo (default 1e-7)
+  int maxiter;    // Numero massimo di iterazioni (default 100)
+  int grain;      // Nodi per lavoro del pool, 0 = automatico (default 0)
+  int width;      // Thread del pool usati al più insieme, 0 = tutti (default
+                  // 0). Permette di dividere un pool grande tra più calcoli
+} pr_params_t;
+
+typedef struct {
+  int nodes;      // Lunghezza di ranks
+  double *ranks;  // Rank di ogni nodo
+  int iterations; // Iterazioni eseguite
+  int converged;  // 1 se l'errore è sceso sotto eps entro maxiter
+} pr_result_t;
+
+// Parametri di default, gli stessi dell'eseguibile pagerank
+void pr_params_default(pr_params_t *params);
+
+// Thread pool riusabile tra più esecuzioni. Le esecuzioni sullo stesso pool
+// vengono serializzate
+pr_pool_t *pr_pool_create(int threads);
+int pr_pool_threads(const pr_pool_t *pool);
+void pr_pool_destroy(pr_pool_t *pool);
+
+// Grafo da array di archi src[i] -> dst[i]. Self-loop, duplicati e archi
+// fuori da [0, nodes) vengono scartati
+pr_graph_t *pr_graph_from_edges(int nodes, const int *src, const int *dst,
+                                long edges);
+
+// Costruzione incrementale: gli archi vengono accodati man mano che arrivano
+// (ad esempio da un socket) e il grafo viene creato da pr_builder_finish,
+// che libera il builder. expected_edges è solo un suggerimento
+pr_builder_t *pr_builder_create(int nodes, long expected_edges);
+int pr_builder_add(pr_builder_t *builder, const int *src, const int *dst,
+                   long edges);
+long pr_builder_edges(const pr_builder_t *builder);
+pr_graph_t *pr_builder_finish(pr_builder_t *builder);
+void pr_builder_free(pr_builder_t *builder);
+
+// Grafo da file MatrixMarket o PRGB, anche compresso, letto con threads
+// consumer. Un file malformato non termina il processo: NULL con errno
+// EINVAL (ENOTSUP per una compressione non compilata, ENOMEM senza memoria)
+pr_graph_t *pr_graph_load(const char *filename, int threads);
+
+int pr_graph_nodes(const pr_graph_t *graph);
+long pr_graph_arcs(const pr_graph_t *graph);
+int pr_graph_dead_ends(const pr_graph_t *graph);
+void pr_graph_free(pr_graph_t *graph);
+
+// Calcola il PageRank del grafo sul pool; i grafi piccoli (vedi
+// PAGERANK_SEQUENTIAL_WORK) sul thread chiamante. params può essere NULL per
+// i valori di default. Il risultato va liberato con pr_result_free
+int pr_run(const pr_graph_t *graph, const pr_params_t *params, pr_pool_t *pool,
+           pr_result_t *result);
+void pr_result_free(pr_result_t *result);
+
+// Scrive i k nodi con rank più alto in ordine decrescente (a parità di rank
+// prima l'id minore). nodes e values possono essere NULL. Ritorna quanti
+// nodi sono stati scritti, cioè min(k, result->nodes)
+int pr_top_k(const pr_result_t *result, int k, int *nodes, double *values);
+
+// Scrive su f lo stesso report dell'eseguibile pagerank (nodi, dead-end,
+// archi, convergenza, somma dei rank e top k)
+int pr_write_report(FILE *f, const pr_graph_t *graph, const pr_result_t *result,
+                    const pr_params_t *params, int k);
+
+// Scrive il vettore completo dei rank in path nel formato binario descritto
+// in rankdump.h (mappabile con mmap), con l'ordine dei nodi per rank se
+// with_order. Ordinamento e scritture usano il pool
+int pr_result_write(const pr_result_t *result, const char *path,
+                    int with_order, pr_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBPAGERANK_H
@@ -0,0 +1,416 @@
+#define _GNU_SOURCE
+#include "loader.h"
+#include "decompress.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Archi passati al buffer con un solo lock
+#define LOADER_BATCH 256
+
+// Buffer di stdio per gli stream, così le pipe vengono lette a blocchi grandi
+#define LOADER_STREAM_BUFFER (1 << 20)
+
+// Stato del produttore: archi in attesa di essere passati al buffer
+typedef struct {
+  buffer_t *buf;
+  tupla batch[LOADER_BATCH];
+  int n;
+} batch_sink_t;
+
+static void flush_batch(batch_sink_t *sink) {
+  buffer_produce_batch(sink->buf, sink->batch, sink->n);
+  sink->n = 0;
+}
+
+static void push_edge(void *arg, int in, int out) {
+  batch_sink_t *sink = (batch_sink_t *)arg;
+  sink->batch[sink->n].IN = in;
+  sink->batch[sink->n].OUT = out;
+  if (++sink->n == LOADER_BATCH)
+    flush_batch(sink);
+}
+
+static void push_terminators(buffer_t *buf, int thread_num) {
+  for (int i = 0; i < thread_num; i++) {
+    tupla t = {.IN = -1, .OUT = -1};
+    buffer_produce(buf, t);
+  }
+}
+
+// Scarta gli id non positivi, che diventerebbero la tupla di terminazione
+// (-1, -1) o indici negativi
+static void emit_edge(edge_fn_t fn, void *arg, long in, long out) {
+  if (in < 0 || out < 0 || in > INT32_MAX || out > INT32_MAX)
+    return;
+  fn(arg, (int)in, (int)out);
+}
+
+// Righe "riga colonna" dopo l'intestazione MatrixMarket
+static long scan_text(FILE *file, edge_fn_t fn, void *arg) {
+  char *line = NULL;
+  size_t len = 0;
+  long edges_read = 0;
+
+  while (getline(&line, &len, file) != -1) {
+    if (line[0] == '%') {
+      continue;
+    }
+
+    char *ptr;
+    long in = strtol(line, &ptr, 10) - 1;
+    if (ptr == line) {
+      continue; // Riga vuota
+    }
+    long out = strtol(ptr, NULL, 10) - 1;
+
+    emit_edge(fn, arg, in, out);
+    edges_read++;
+  }
+
+  free(line);
+  if (ferror(file)) {
+    errno = EIO;
+    return -1;
+  }
+  return edges_read;
+}
+
+static uint32_t le32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint64_t le64(const unsigned char *p) {
+  return (uint64_t)le32(p) | (uint64_t)le32(p + 4) << 32;
+}
+
+// Coppie int32 little endian dopo l'intestazione PRGB
+static long scan_binary(FILE *file, uint64_t edges, edge_fn_t fn, void *arg) {
+  unsigned char raw[LOADER_BATCH * 8];
+  uint64_t remaining = edges;
+  long edges_read = 0;
+
+  while (remaining > 0) {
+    size_t want = remaining < LOADER_BATCH ? (size_t)remaining : LOADER_BATCH;
+    size_t got = fread(raw, 8, want, file);
+
+    for (size_t i = 0; i < got; i++) {
+      long in = (long)(int32_t)le32(raw + 8 * i) - 1;
+      long out = (long)(int32_t)le32(raw + 8 * i + 4) - 1;
+      emit_edge(fn, arg, in, out);
+    }
+    edges_read += got;
+    if (edges != PRGB_EDGES_UNKNOWN)
+      remaining -= got;
+
+    if (got < want) {
+      if (ferror(file) || (edges != PRGB_EDGES_UNKNOWN && remaining > 0)) {
+        errno = ferror(file) ? EIO : EINVAL; // Errore di lettura o troncato
+        return -1;
+      }
+      break;
+    }
+  }
+
+  return edges_read;
+}
+
+int read_stream_header(FILE *file, stream_header_t *h) {
+  int c = fgetc(file);
+  if (c == EOF) {
+    errno = ferror(file) ? EIO : EINVAL; // Stream vuoto
+    return -1;
+  }
+  ungetc(c, file);
+
+  // Un file MatrixMarket inizia con un commento o con un numero
+  h->binary = c == PRGB_MAGIC[0];
+  h->edges = PRGB_EDGES_UNKNOWN;
+  h->arcs_hint = -1;
+
+  if (h->binary) {
+    unsigned char raw[PRGB_HEADER_SIZE];
+    if (fread(raw, 1, sizeof(raw), file) != sizeof(raw) ||
+        memcmp(raw, PRGB_MAGIC, 4) != 0 || le32(raw + 4) != PRGB_VERSION ||
+        le32(raw + 8) > INT32_MAX) {
+      errno = EINVAL;
+      return -1;
+    }
+    h->edges = le64(raw + 16);
+    h->nodes = (int)le32(raw + 8);
+    if (h->edges <= INT64_MAX)
+      h->arcs_hint = (long)h->edges;
+    return h->nodes;
+  }
+
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, file) != -1) {
+    if (line[0] == '%') {
+      continue;
+    }
+    char *ptr;
+    long size = strtol(line, &ptr, 10);
+    if (ptr == line || size < 0 || size > INT32_MAX) {
+      free(line);
+      errno = EINVAL;
+      return -1;
+    }
+    // "nodi nodi archi": il numero di archi è facoltativo
+    char *end;
+    strtol(ptr, &end, 10);
+    long arcs = strtol(end, &ptr, 10);
+    if (ptr != end && arcs >= 0)
+      h->arcs_hint = arcs;
+    free(line);
+    h->nodes = (int)size;
+    return h->nodes;
+  }
+
+  free(line);
+  errno = ferror(file) ? EIO : EINVAL; // Dimensione della mappa non trovata
+  return -1;
+}
+
+long read_stream_edges(FILE *file, const stream_header_t *h, edge_fn_t fn,
+                       void *arg) {
+  return h->binary ? scan_binary(file, h->edges, fn, arg)
+                   : scan_text(file, fn, arg);
+}
+
+// Passa gli archi dello stream al buffer dei consumer a blocchi
+static long produce_edges(FILE *file, const stream_header_t *h,
+                          buffer_t *buf) {
+  batch_sink_t sink = {.buf = buf, .n = 0};
+  long edges_read = read_stream_edges(file, h, push_edge, &sink);
+  flush_batch(&sink);
+  return edges_read;
+}
+
+void *consumer(void *arg) {
+  consumer_args_t *args = (consumer_args_t *)arg;
+  buffer_t *buf = args->buffer;
+  inmap *map = args->map;
+  outgoing_edges_t *out = args->out;
+  tupla items[LOADER_BATCH];
+
+  while (1) {
+    int n = buffer_consume_batch(buf, items, LOADER_BATCH);
+    for (int i = 0; i < n; i++) {
+      if (items[i].IN == -1 && items[i].OUT == -1) {
+        return (void *)0;
+      }
+      // Senza memoria il consumer continua a svuotare il buffer, altrimenti
+      // il produttore resterebbe bloccato
+      if (insert_inmap(map, items[i].IN, items[i].OUT, out) != 0)
+        __atomic_store_n(&args->failed, true, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// Archi raccolti dal caricamento in sequenza, in un'unica allocazione:
+// sorgenti nella prima metà, destinazioni nella seconda
+typedef struct {
+  int *arena;
+  long num;
+  long cap;
+  bool failed; // Manca memoria: gli archi successivi vengono ignorati
+} edge_arena_t;
+
+static void arena_edge(void *arg, int in, int out) {
+  edge_arena_t *e = (edge_arena_t *)arg;
+  if (e->failed)
+    return;
+  if (e->num == e->cap) {
+    long cap = e->cap * 2;
+    int *arena = (int *)realloc(e->arena, 2 * cap * sizeof(int));
+    if (arena == NULL) {
+      e->failed = true;
+      return;
+    }
+    memmove(arena + cap, arena + e->cap, e->num * sizeof(int));
+    e->arena = arena;
+    e->cap = cap;
+  }
+  e->arena[e->num] = in;
+  e->arena[e->cap + e->num] = out;
+  e->num++;
+}
+
+// Grafi piccoli: per pochi archi avviare i consumer e passare dal buffer
+// costa più della lettura stessa
+static grafo *load_sequential(FILE *file, const stream_header_t *h,
+                              stats_t *stats) {
+  stats_begin(stats, PHASE_ALLOC);
+  edge_arena_t e = {.num = 0, .cap = h->arcs_hint > 0 ? h->arcs_hint : 1};
+  e.arena = (int *)malloc(2 * e.cap * sizeof(int));
+  if (e.arena == NULL) {
+    return NULL;
+  }
+  stats_end(stats, PHASE_ALLOC);
+
+  stats_begin(stats, PHASE_PARSE);
+  long edges_read = read_stream_edges(file, h, arena_edge, &e);
+  stats_end(stats, PHASE_PARSE);
+  if (edges_read < 0 || e.failed) {
+    if (e.failed)
+      errno = ENOMEM;
+    free(e.arena);
+    return NULL;
+  }
+
+  stats_begin(stats, PHASE_BUILD);
+  grafo *g = grafo_from_edges(h->nodes, e.arena, e.arena + e.cap, e.num);
+  free(e.arena);
+  stats_end(stats, PHASE_BUILD);
+
+  if (stats != NULL)
+    stats->edges_read = edges_read;
+
+  return g;
+}
+
+// Chiude il decompressore: un errore di decompressione scarta il grafo,
+// costruito da uno stream incompleto
+static grafo *finish_stream(decompressor_t *dec, grafo *g) {
+  if (decompress_close(dec) != 0) {
+    int err = errno;
+    free_grafo(g);
+    errno = err;
+    return NULL;
+  }
+  return g;
+}
+
+grafo *load_graph_stream(FILE *src, int thread_num, stats_t *stats) {
+  // Va fatto prima di qualsiasi lettura dallo stream
+  setvbuf(src, NULL, _IOFBF, LOADER_STREAM_BUFFER);
+
+  // Input gzip/zstd: si legge dalla pipe del thread di decompressione
+  FILE *file;
+  decompressor_t *dec = decompress_open(src, thread_num, &file);
+  if (file == NULL)
+    return NULL;
+  if (dec != NULL)
+    setvbuf(file, NULL, _IOFBF, LOADER_STREAM_BUFFER);
+
+  stats_begin(stats, PHASE_READ_SIZE);
+  stream_header_t h;
+  int size = read_stream_header(file, &h);
+  stats_end(stats, PHASE_READ_SIZE);
+  if (size < 0) {
+    // Un errore del decompressore spiega meglio l'intestazione mancante
+    int err = errno;
+    if (decompress_close(dec) == 0)
+      errno = err;
+    return NULL;
+  }
+
+  if (h.arcs_hint >= 0 && h.arcs_hint <= LOADER_SEQUENTIAL_ARCS) {
+    grafo *g = load_sequential(file, &h, stats);
+    if (g == NULL) {
+      int err = errno;
+      if (decompress_close(dec) == 0)
+        errno = err;
+      return NULL;
+    }
+    return finish_stream(dec, g);
+  }
+
+  stats_begin(stats, PHASE_ALLOC);
+  buffer_t *cb = (buffer_t *)calloc(1, sizeof(buffer_t));
+  inmap *map = create_inmap(size);
+  outgoing_edges_t *out = create_outgoing_edges(size);
+  consumer_args_t *ca = (consumer_args_t *)calloc(1, sizeof(consumer_args_t));
+  pthread_t *threads = (pthread_t *)calloc(thread_num, sizeof(pthread_t));
+  if (cb != NULL)
+    buffer_init(cb, 2048);
+  if (cb == NULL || cb->buffer == NULL || map == NULL || out == NULL ||
+      ca == NULL || threads == NULL) {
+    if (cb != NULL)
+      buffer_destroy(cb);
+    free(cb);
+    if (map != NULL)
+      free_inmap(map);
+    if (out != NULL)
+      free_outgoing_edges(out);
+    free(ca);
+    free(threads);
+    decompress_close(dec);
+    errno = ENOMEM;
+    return NULL;
+  }
+  ca->buffer = cb;
+  ca->map = map;
+  ca->out = out;
+  stats_end(stats, PHASE_ALLOC);
+
+  // I consumer partono prima della lettura: gli archi vengono inseriti
+  // nell'inmap mentre il resto dello stream sta ancora arrivando
+  long edges_read = 0;
+  stats_begin(stats, PHASE_PARSE);
+  for (int i = 0; i < thread_num; i++) {
+    pthread_create(&threads[i], NULL, consumer, (void *)ca);
+  }
+
+  // Anche se lo stream è malformato i consumer ricevono la terminazione
+  edges_read = produce_edges(file, &h, cb);
+  int err = errno;
+  push_terminators(cb, thread_num);
+  stats_end(stats, PHASE_PARSE);
+
+  stats_begin(stats, PHASE_BUILD);
+  for (int i = 0; i < thread_num; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  buffer_destroy(cb);
+  free(cb);
+  bool failed = ca->failed;
+  free(ca);
+
+  // L'array dei gradi uscenti passa al grafo, il mutex non serve più
+  int *out_degree = out->outgoing_edges;
+  pthread_mutex_destroy(&(out->mutex));
+  free(out);
+
+  if (edges_read < 0 || failed) {
+    free_inmap(map);
+    free(out_degree);
+    err = failed ? ENOMEM : err;
+    if (decompress_close(dec) == 0)
+      errno = err;
+    return NULL;
+  }
+
+  grafo *g = grafo_from_inmap(map, out_degree);
+  stats_end(stats, PHASE_BUILD);
+  if (g == NULL) {
+    decompress_close(dec);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  if (stats != NULL)
+    stats->edges_read = edges_read;
+
+  return finish_stream(dec, g);
+}
+
+grafo *load_graph(char *filename, int thread_num, stats_t *stats) {
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+
+  grafo *g = load_graph_stream(file, thread_num, stats);
+  int err = errno;
+  fclose(file);
+  errno = err;
+  return g;
+}
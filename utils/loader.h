@@ -0,0 +1,81 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "graph.h"
+#include "nodebuffer.h"
+#include "stats.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Formato binario degli stream (tutti i campi little endian):
+//
+//   offset  0  char[4]  magic "PRGB"
+//   offset  4  uint32   versione (1)
+//   offset  8  uint32   numero di nodi
+//   offset 12  uint32   riservato (0)
+//   offset 16  uint64   numero di archi, PRGB_EDGES_UNKNOWN = fino a EOF
+//   offset 24  archi: coppie int32 (riga, colonna) con id 1-based, nello
+//              stesso ordine delle righe di un file MatrixMarket
+#define PRGB_MAGIC "PRGB"
+#define PRGB_VERSION 1
+#define PRGB_HEADER_SIZE 24
+#define PRGB_EDGES_UNKNOWN UINT64_MAX
+
+// Intestazione di uno stream, letta da read_stream_header
+typedef struct {
+  int nodes;
+  bool binary;
+  uint64_t edges; // Solo formato binario, altrimenti PRGB_EDGES_UNKNOWN
+  long arcs_hint; // Archi dichiarati (terzo numero MatrixMarket o edges del
+                  // binario), -1 se mancano. Solo indicativo
+} stream_header_t;
+
+// Archi dichiarati fino ai quali load_graph_stream costruisce il grafo sul
+// thread chiamante, senza buffer né consumer
+#define LOADER_SEQUENTIAL_ARCS (1 << 17)
+
+// Riceve un arco origine -> destinazione con id 0-based non negativi
+typedef void (*edge_fn_t)(void *arg, int in, int out);
+
+typedef struct {
+  buffer_t *buffer;
+  inmap *map;
+  outgoing_edges_t *out;
+  bool failed; // Un consumer è rimasto senza memoria
+} consumer_args_t;
+
+// Riconosce il formato dal primo byte e legge l'intestazione, lasciando lo
+// stream sul primo arco. Ritorna il numero di nodi, -1 con errno EINVAL se
+// l'intestazione manca o non è valida (EIO per un errore di lettura)
+int read_stream_header(FILE *file, stream_header_t *h);
+
+// Legge gli archi che seguono l'intestazione chiamando fn per ognuno, senza
+// costruire il grafo. Ritorna il numero di archi letti, -1 con errno EINVAL
+// se lo stream binario è troncato (EIO per un errore di lettura)
+long read_stream_edges(FILE *file, const stream_header_t *h, edge_fn_t fn,
+                       void *arg);
+
+// Thread consumer: preleva archi dal buffer e li inserisce nell'inmap
+void *consumer(void *arg);
+
+// Carica il grafo da uno stream già aperto (file, pipe o stdin) in una sola
+// passata: il formato, MatrixMarket testuale o binario PRGB, viene
+// riconosciuto dal primo byte e gli archi passano ai consumer man mano che
+// arrivano. Un input compresso gzip o zstd viene decompresso al volo (vedi
+// decompress.h). Se l'intestazione dichiara al più LOADER_SEQUENTIAL_ARCS
+// archi il grafo viene costruito in sequenza, senza avviare thread. Lo
+// stream non viene chiuso. stats può essere NULL.
+// Non termina mai il processo: con un input malformato, compresso in modo
+// non valido o senza memoria ritorna NULL con errno impostato (EINVAL,
+// ENOTSUP, EIO, ENOMEM), così un errore su un file non ferma un batch né il
+// processo che usa libpagerank
+grafo *load_graph_stream(FILE *file, int thread_num, stats_t *stats);
+
+// Carica il grafo dal file usando thread_num consumer. stats può essere
+// NULL. Come load_graph_stream, NULL con errno impostato in caso di errore
+// (anche se il file non si apre)
+grafo *load_graph(char *filename, int thread_num, stats_t *stats);
+
+#endif // LOADER_H
@@ -0,0 +1,279 @@
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Campi del seqlock letti e scritti con operazioni atomiche rilassate:
+// l'ordine lo danno le barriere attorno a seq
+#define STORE(field, value)                                                    \
+  do {                                                                         \
+    __typeof__(field) v_ = (value);                                            \
+    __atomic_store(&(field), &v_, __ATOMIC_RELAXED);                           \
+  } while (0)
+#define LOAD(dst, field) __atomic_load(&(field), &(dst), __ATOMIC_RELAXED)
+
+metrics_page_t *metrics_create(const char *path, int top_k) {
+  void *map;
+  if (path == NULL) {
+    map = mmap(NULL, sizeof(metrics_page_t), PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return NULL;
+    map = MAP_FAILED;
+    if (ftruncate(fd, sizeof(metrics_page_t)) == 0)
+      map = mmap(NULL, sizeof(metrics_page_t), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+  }
+  if (map == MAP_FAILED)
+    return NULL;
+
+  metrics_page_t *m = (metrics_page_t *)map;
+  m->version = METRICS_VERSION;
+  m->pid = getpid();
+  m->state = METRICS_LOADING;
+  m->top_k = top_k < METRICS_MAX_TOP ? top_k : METRICS_MAX_TOP;
+  for (int i = 0; i < METRICS_MAX_TOP; i++)
+    m->top_node[i] = -1;
+  m->on_demand = path == NULL;
+
+  // Chi trova il magic vede anche il resto dell'intestazione
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(m->magic, METRICS_MAGIC, 4);
+  return m;
+}
+
+void metrics_close(metrics_page_t *m) {
+  if (m != NULL)
+    munmap(m, sizeof(metrics_page_t));
+}
+
+const metrics_page_t *metrics_attach(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size == sizeof(metrics_page_t))
+    map = mmap(NULL, sizeof(metrics_page_t), PROT_READ, MAP_SHARED, fd, 0);
+  else
+    errno = EINVAL;
+  int saved = errno;
+  close(fd);
+  errno = saved;
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const metrics_page_t *m = (const metrics_page_t *)map;
+  if (memcmp(m->magic, METRICS_MAGIC, 4) != 0 ||
+      m->version != METRICS_VERSION) {
+    munmap(map, sizeof(metrics_page_t));
+    errno = EINVAL;
+    return NULL;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return m;
+}
+
+void metrics_detach(const metrics_page_t *m) {
+  if (m != NULL)
+    munmap((void *)m, sizeof(metrics_page_t));
+}
+
+// Un solo scrittore: seq dispari mentre i campi cambiano
+static void write_begin(metrics_page_t *m) {
+  uint64_t seq = __atomic_load_n(&m->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&m->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(metrics_page_t *m) {
+  uint64_t seq = __atomic_load_n(&m->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&m->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+void metrics_begin(metrics_page_t *m, int nodes, long arcs, int maxiter,
+                   int threads) {
+  write_begin(m);
+  STORE(m->state, METRICS_RUNNING);
+  STORE(m->nodes, nodes);
+  STORE(m->arcs, arcs);
+  STORE(m->iteration, 0);
+  STORE(m->maxiter, maxiter);
+  STORE(m->error, 0.0);
+  STORE(m->dangling, 0.0);
+  STORE(m->edges_per_sec, 0.0);
+  STORE(m->elapsed, 0.0);
+  write_end(m);
+  m->top_at = 0; // La prima iterazione pubblica la classifica
+
+  int n = threads < METRICS_MAX_THREADS ? threads : METRICS_MAX_THREADS;
+  STORE(m->threads, n);
+}
+
+void metrics_publish(metrics_page_t *m, int iteration, double error,
+                     double dangling, double elapsed, const int *top,
+                     int top_n, const double *X) {
+  int64_t arcs;
+  int32_t k;
+  LOAD(arcs, m->arcs);
+  LOAD(k, m->top_k);
+  if (top_n > k)
+    top_n = k;
+
+  write_begin(m);
+  STORE(m->iteration, iteration);
+  STORE(m->error, error);
+  STORE(m->dangling, dangling);
+  STORE(m->elapsed, elapsed);
+  STORE(m->edges_per_sec,
+        elapsed > 0 ? (double)arcs * iteration / elapsed : 0.0);
+  if (top != NULL) {
+    for (int i = 0; i < top_n; i++) {
+      STORE(m->top_node[i], top[i]);
+      STORE(m->top_rank[i], X[top[i]]);
+    }
+    for (int i = top_n; i < k; i++)
+      STORE(m->top_node[i], -1);
+    STORE(m->served, m->taken);
+  }
+  write_end(m);
+}
+
+void metrics_end(metrics_page_t *m) {
+  write_begin(m);
+  STORE(m->state, METRICS_DONE);
+  write_end(m);
+}
+
+bool metrics_top_due(metrics_page_t *m) {
+  uint64_t r = __atomic_load_n(&m->requests, __ATOMIC_ACQUIRE);
+  if (r != m->taken) {
+    m->taken = r;
+    return true;
+  }
+  if (m->on_demand)
+    return false;
+
+  // Nel file la classifica si aggiorna anche senza richieste, ma a tempo:
+  // una selezione a ogni iterazione costa quanto una parte del calcolo
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  double now = ts.tv_sec + ts.tv_nsec * 1e-9;
+  if (now - m->top_at < METRICS_TOP_PERIOD)
+    return false;
+  m->top_at = now;
+  return true;
+}
+
+uint64_t metrics_request_top(metrics_page_t *m) {
+  return __atomic_add_fetch(&m->requests, 1, __ATOMIC_RELEASE);
+}
+
+void metrics_add_busy(metrics_page_t *m, int id, uint64_t ns) {
+  if (id < METRICS_MAX_THREADS)
+    __atomic_fetch_add(&m->busy_ns[id], ns, __ATOMIC_RELAXED);
+}
+
+void metrics_read(const metrics_page_t *m, metrics_page_t *snap) {
+  memcpy(snap->magic, m->magic, 4);
+  snap->version = m->version;
+  snap->pid = m->pid;
+
+  uint64_t seq;
+  do {
+    do
+      seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+    while (seq & 1);
+
+    LOAD(snap->state, m->state);
+    LOAD(snap->nodes, m->nodes);
+    LOAD(snap->arcs, m->arcs);
+    LOAD(snap->iteration, m->iteration);
+    LOAD(snap->maxiter, m->maxiter);
+    LOAD(snap->error, m->error);
+    LOAD(snap->dangling, m->dangling);
+    LOAD(snap->edges_per_sec, m->edges_per_sec);
+    LOAD(snap->elapsed, m->elapsed);
+    LOAD(snap->served, m->served);
+    LOAD(snap->top_k, m->top_k);
+    for (int i = 0; i < snap->top_k && i < METRICS_MAX_TOP; i++) {
+      LOAD(snap->top_node[i], m->top_node[i]);
+      LOAD(snap->top_rank[i], m->top_rank[i]);
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&m->seq, __ATOMIC_RELAXED) != seq);
+  snap->seq = seq;
+
+  LOAD(snap->threads, m->threads);
+  for (int i = 0; i < snap->threads && i < METRICS_MAX_THREADS; i++)
+    LOAD(snap->busy_ns[i], m->busy_ns[i]);
+}
+
+static const char *state_name(uint32_t state) {
+  switch (state) {
+  case METRICS_LOADING:
+    return "loading";
+  case METRICS_RUNNING:
+    return "running";
+  default:
+    return "done";
+  }
+}
+
+static void gauge(FILE *f, const char *name, const char *help, long pid,
+                  double value) {
+  fprintf(f, "# HELP pagerank_%s %s\n# TYPE pagerank_%s gauge\n", name, help,
+          name);
+  fprintf(f, "pagerank_%s{pid=\"%ld\"} %.17g\n", name, pid, value);
+}
+
+void metrics_print_prometheus(FILE *f, const metrics_page_t *snap) {
+  long pid = (long)snap->pid;
+
+  fprintf(f, "# HELP pagerank_state Current phase (1 for the active one)\n"
+             "# TYPE pagerank_state gauge\n");
+  for (uint32_t s = METRICS_LOADING; s <= METRICS_DONE; s++)
+    fprintf(f, "pagerank_state{pid=\"%ld\",state=\"%s\"} %d\n", pid,
+            state_name(s), snap->state == s);
+
+  gauge(f, "nodes", "Nodes of the graph", pid, snap->nodes);
+  gauge(f, "arcs", "Valid arcs of the graph", pid, (double)snap->arcs);
+  gauge(f, "iteration", "Completed iterations", pid, snap->iteration);
+  gauge(f, "max_iterations", "Iteration limit", pid, snap->maxiter);
+  gauge(f, "error", "L1 error of the last iteration", pid, snap->error);
+  gauge(f, "dangling_mass", "Rank mass held by dead-end nodes", pid,
+        snap->dangling);
+  gauge(f, "edges_per_second", "Arcs processed per second", pid,
+        snap->edges_per_sec);
+  gauge(f, "elapsed_seconds", "Seconds since the iteration started", pid,
+        snap->elapsed);
+
+  fprintf(f, "# HELP pagerank_thread_busy_seconds_total Time spent running "
+             "pool jobs\n# TYPE pagerank_thread_busy_seconds_total counter\n");
+  for (int i = 0; i < snap->threads && i < METRICS_MAX_THREADS; i++)
+    fprintf(f, "pagerank_thread_busy_seconds_total{pid=\"%ld\",thread=\"%d\"} "
+               "%.9f\n",
+            pid, i, snap->busy_ns[i] / 1e9);
+
+  fprintf(f, "# HELP pagerank_top_rank Current rank of the top nodes\n"
+             "# TYPE pagerank_top_rank gauge\n");
+  for (int i = 0; i < snap->top_k && i < METRICS_MAX_TOP; i++) {
+    if (snap->top_node[i] < 0)
+      break;
+    fprintf(f, "pagerank_top_rank{pid=\"%ld\",position=\"%d\",node=\"%d\"} "
+               "%.17g\n",
+            pid, i + 1, snap->top_node[i], snap->top_rank[i]);
+  }
+}
@@ -0,0 +1,103 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Pagina delle metriche del calcolo in corso, in memoria condivisa (file
+// mappato con --metrics PATH, ad esempio in /dev/shm) oppure anonima. Il
+// thread che itera la aggiorna una volta per iterazione con un seqlock e i
+// worker del thread pool sommano ognuno il proprio tempo di lavoro con
+// operazioni atomiche: chi legge non prende lock e non ferma il calcolo,
+// e può leggere con qualsiasi frequenza (vedi metrics_read).
+
+#define METRICS_MAGIC "PRMT"
+#define METRICS_VERSION 2
+#define METRICS_MAX_TOP 64
+#define METRICS_MAX_THREADS 256
+
+// Secondi tra due classifiche nella pagina su file: le altre iterazioni
+// pubblicano solo i contatori, senza selezionare i primi nodi
+#define METRICS_TOP_PERIOD 0.5
+
+enum { METRICS_LOADING = 0, METRICS_RUNNING = 1, METRICS_DONE = 2 };
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  int64_t pid;
+  uint64_t seq; // Dispari durante un aggiornamento dei campi che seguono
+
+  // Protetti dal seqlock
+  uint32_t state;
+  int32_t nodes;
+  int64_t arcs;
+  int32_t iteration;
+  int32_t maxiter;
+  double error;         // Errore L1 dell'ultima iterazione
+  double dangling;      // Massa dei nodi dead-end (S)
+  double edges_per_sec; // Archi elaborati al secondo dall'inizio del calcolo
+  double elapsed;       // Secondi dall'inizio del calcolo
+  int32_t top_k;        // Nodi validi in top_node
+  int32_t top_node[METRICS_MAX_TOP];
+  double top_rank[METRICS_MAX_TOP];
+  uint64_t served; // Ultimo valore di requests soddisfatto dalla classifica
+
+  // Fuori dal seqlock. Classifica su richiesta: chi la vuole incrementa
+  // requests, chi scrive la calcola all'iterazione successiva
+  int32_t on_demand;
+  uint64_t requests;
+  uint64_t taken; // Solo per chi scrive: ultima richiesta presa in carico
+  double top_at;  // Solo per chi scrive: istante dell'ultima classifica
+
+  // Ogni worker scrive solo il suo contatore
+  int32_t threads;
+  uint64_t busy_ns[METRICS_MAX_THREADS];
+} metrics_page_t;
+
+// Crea la pagina nel file path (troncato) oppure, con path NULL, in memoria
+// anonima del processo. top_k (al più METRICS_MAX_TOP) sono i nodi della
+// classifica pubblicati su richiesta (metrics_request_top) e, solo nel file,
+// anche ogni METRICS_TOP_PERIOD secondi. NULL in caso di errore, con errno
+// impostato
+metrics_page_t *metrics_create(const char *path, int top_k);
+
+// Stacca la pagina; il file resta con l'ultimo stato pubblicato
+void metrics_close(metrics_page_t *m);
+
+// Apre in lettura la pagina di un altro processo. NULL se il file non è una
+// pagina di metriche (errno EINVAL)
+const metrics_page_t *metrics_attach(const char *path);
+void metrics_detach(const metrics_page_t *m);
+
+// Lato calcolo: inizio e fine del calcolo, poi un'iterazione alla volta.
+// top contiene top_n nodi in ordine di classifica con i rank in X; con top
+// NULL la classifica pubblicata resta quella precedente
+void metrics_begin(metrics_page_t *m, int nodes, long arcs, int maxiter,
+                   int threads);
+void metrics_publish(metrics_page_t *m, int iteration, double error,
+                     double dangling, double elapsed, const int *top,
+                     int top_n, const double *X);
+void metrics_end(metrics_page_t *m);
+
+// Vero se l'iterazione in corso deve calcolare la classifica: c'è una
+// richiesta nuova o, nella pagina su file, è passato METRICS_TOP_PERIOD
+// dall'ultima
+bool metrics_top_due(metrics_page_t *m);
+
+// Chiede la classifica alla prossima iterazione: è pubblicata quando served
+// raggiunge il valore ritornato
+uint64_t metrics_request_top(metrics_page_t *m);
+
+// Lato worker: somma ns al tempo di lavoro del thread id
+void metrics_add_busy(metrics_page_t *m, int id, uint64_t ns);
+
+// Copia coerente della pagina: riprova finché non legge tra due
+// aggiornamenti
+void metrics_read(const metrics_page_t *m, metrics_page_t *snap);
+
+// Formato testuale di Prometheus
+void metrics_print_prometheus(FILE *f, const metrics_page_t *snap);
+
+#endif // METRICS_H
@@ -0,0 +1,291 @@
+#include "montecarlo.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cammini per lavoro del pool: fisso, così la divisione in lavori (e i
+// generatori) non dipende dal numero di thread
+#define MC_WALKS_PER_JOB (1 << 14)
+
+// Cammini portati avanti insieme da un lavoro
+#define MC_LANES 16
+
+// Archi uscenti in CSR, trasposti dalle liste entranti di g. Il nodo N
+// rappresenta tutti i nodi isolati esclusi da g
+typedef struct {
+  int N;
+  long total; // Nodi compresi gli isolati
+  long *out_off;
+  int *out_idx;
+} walk_graph_t;
+
+typedef struct {
+  const walk_graph_t *wg;
+  double d;
+  uint64_t seed;
+  long first; // Cammini [first, last) di walks
+  long last;
+  long walks;
+  uint64_t *visits; // Visite per nodo, sommate con operazioni atomiche
+  uint64_t *repeat; // Somma di V * (V - 1) sui cammini che visitano il nodo
+                    // V > 1 volte, per la varianza
+  long steps;
+} walk_job_t;
+
+static uint64_t splitmix64(uint64_t *s) {
+  uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Intero uniforme in [0, n)
+static uint64_t below(uint64_t *s, uint64_t n) {
+  return (uint64_t)(((unsigned __int128)splitmix64(s) * n) >> 64);
+}
+
+static int random_node(uint64_t *s, const walk_graph_t *wg) {
+  uint64_t r = below(s, wg->total);
+  return r < (uint64_t)wg->N ? (int)r : wg->N;
+}
+
+static int build_walk_graph(const grafo *g, int isolated, walk_graph_t *wg) {
+  wg->N = g->N;
+  wg->total = (long)g->N + isolated;
+  if (grafo_out_lists(g, &wg->out_off, &wg->out_idx) != 0)
+    return -1;
+
+  // Il nodo degli isolati è un dead-end: un offset in più
+  long *off = (long *)realloc(wg->out_off, ((size_t)g->N + 2) * sizeof(long));
+  if (off == NULL) {
+    free(wg->out_off);
+    free(wg->out_idx);
+    return -1;
+  }
+  off[g->N + 1] = off[g->N];
+  wg->out_off = off;
+  return 0;
+}
+
+// Conta le visite del cammino: il percorso viene ordinato per contare quante
+// volte compare ogni nodo
+static void record_walk(walk_job_t *j, int *path, int len) {
+  for (int i = 1; i < len; i++) {
+    int v = path[i];
+    int k = i - 1;
+    while (k >= 0 && path[k] > v) {
+      path[k + 1] = path[k];
+      k--;
+    }
+    path[k + 1] = v;
+  }
+
+  for (int i = 0; i < len;) {
+    int k = i + 1;
+    while (k < len && path[k] == path[i])
+      k++;
+    uint64_t times = k - i;
+    __atomic_fetch_add(&j->visits[path[i]], times, __ATOMIC_RELAXED);
+    if (times > 1)
+      __atomic_fetch_add(&j->repeat[path[i]], times * (times - 1),
+                         __ATOMIC_RELAXED);
+    i = k;
+  }
+}
+
+// Nodo di partenza del cammino w: partenze equidistanti su tutti i nodi,
+// anche con meno cammini che nodi
+static int start_node(const walk_graph_t *wg, long w, long walks) {
+  long start = (long)((unsigned __int128)w * wg->total / walks);
+  return start < wg->N ? (int)start : wg->N;
+}
+
+static void walk_job(void *arg) {
+  walk_job_t *j = (walk_job_t *)arg;
+  const walk_graph_t *wg = j->wg;
+  uint64_t s = j->seed;
+
+  // MC_LANES cammini avanzano a turno: i loro accessi al grafo sono
+  // indipendenti, quindi le attese sulla memoria si sovrappongono
+  int cap[MC_LANES];
+  int len[MC_LANES];
+  int node[MC_LANES];
+  int *path[MC_LANES];
+  int active = 0;
+  long next = j->first;
+  long steps = 0;
+
+  for (int l = 0; l < MC_LANES; l++) {
+    cap[l] = 64;
+    path[l] = (int *)malloc(cap[l] * sizeof(int));
+    len[l] = 0;
+    node[l] = -1;
+    if (next < j->last) {
+      node[l] = start_node(wg, next++, j->walks);
+      active++;
+    }
+  }
+
+  while (active > 0) {
+    for (int l = 0; l < MC_LANES; l++) {
+      if (node[l] < 0)
+        continue;
+
+      int v = node[l];
+      if (len[l] == cap[l]) {
+        cap[l] *= 2;
+        path[l] = (int *)realloc(path[l], cap[l] * sizeof(int));
+      }
+      path[l][len[l]++] = v;
+
+      if ((splitmix64(&s) >> 11) * 0x1.0p-53 < j->d) {
+        long deg = wg->out_off[v + 1] - wg->out_off[v];
+        if (deg == 0)
+          v = random_node(&s, wg);
+        else
+          v = wg->out_idx[wg->out_off[v] + (long)below(&s, deg)];
+        __builtin_prefetch(&wg->out_off[v]);
+        node[l] = v;
+        continue;
+      }
+
+      // Cammino finito: conta le visite e ne parte un altro sulla corsia
+      steps += len[l];
+      record_walk(j, path[l], len[l]);
+      len[l] = 0;
+      if (next < j->last) {
+        node[l] = start_node(wg, next++, j->walks);
+      } else {
+        node[l] = -1;
+        active--;
+      }
+    }
+  }
+
+  for (int l = 0; l < MC_LANES; l++)
+    free(path[l]);
+  j->steps = steps;
+}
+
+int pagerank_montecarlo(grafo *g, const montecarlo_params_t *params,
+                        thread_pool_t *tpool, montecarlo_result_t *result,
+                        stats_t *stats) {
+  if (result != NULL) {
+    result->ranks = NULL;
+    result->se = NULL;
+  }
+  if (g == NULL || params == NULL || result == NULL || params->walks <= 0 ||
+      params->d <= 0 || params->d >= 1 || params->isolated < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  bool timing = stats != NULL && stats->enabled;
+  if (timing)
+    tp_enable_stats(tpool);
+
+  walk_graph_t wg;
+  if (build_walk_graph(g, params->isolated, &wg) != 0)
+    return -1;
+
+  // Il nodo N raccoglie le visite a tutti i nodi isolati
+  int slots = g->N + (params->isolated > 0 ? 1 : 0);
+  uint64_t *visits = (uint64_t *)calloc(slots + 1, sizeof(uint64_t));
+  uint64_t *repeat = (uint64_t *)calloc(slots + 1, sizeof(uint64_t));
+  long jobs_num = (params->walks + MC_WALKS_PER_JOB - 1) / MC_WALKS_PER_JOB;
+  walk_job_t *jobs = (walk_job_t *)calloc(jobs_num, sizeof(walk_job_t));
+  result->ranks = (double *)malloc((slots > 0 ? slots : 1) * sizeof(double));
+  result->se = (double *)malloc((slots > 0 ? slots : 1) * sizeof(double));
+  if (visits == NULL || repeat == NULL || jobs == NULL ||
+      result->ranks == NULL || result->se == NULL) {
+    free(visits);
+    free(repeat);
+    free(jobs);
+    free(wg.out_off);
+    free(wg.out_idx);
+    montecarlo_free(result);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (long i = 0; i < jobs_num; i++) {
+    uint64_t seed = params->seed + (uint64_t)i * 0x2545f4914f6cdd1dull;
+    jobs[i] = (walk_job_t){.wg = &wg,
+                           .d = params->d,
+                           .seed = splitmix64(&seed),
+                           .first = i * MC_WALKS_PER_JOB,
+                           .last = (i + 1) * MC_WALKS_PER_JOB < params->walks
+                                       ? (i + 1) * MC_WALKS_PER_JOB
+                                       : params->walks,
+                           .walks = params->walks,
+                           .visits = visits,
+                           .repeat = repeat};
+    tp_add_work(tpool, walk_job, &jobs[i]);
+  }
+  tp_wait(tpool);
+
+  result->walks = params->walks;
+  result->steps = 0;
+  for (long i = 0; i < jobs_num; i++)
+    result->steps += jobs[i].steps;
+
+  // Rank = visite del nodo su tutte le visite: è (1 - d) * media delle
+  // visite per cammino con 1 / (1 - d), la lunghezza attesa di un cammino,
+  // sostituita da quella misurata, così i rank sommano a 1. Errore standard
+  // dalla varianza campionaria delle visite (somma dei quadrati = visits +
+  // repeat)
+  double W = (double)params->walks;
+  double scale = result->steps > 0 ? W / result->steps : 0;
+  for (int i = 0; i < slots; i++) {
+    double mean = visits[i] / W;
+    double sq = (double)visits[i] + (double)repeat[i];
+    double var = W > 1 ? (sq - W * mean * mean) / (W - 1) : 0;
+    result->ranks[i] = scale * mean;
+    result->se[i] = scale * sqrt(var > 0 ? var / W : 0);
+  }
+  if (params->isolated > 0) {
+    result->ranks[g->N] /= params->isolated;
+    result->se[g->N] /= params->isolated;
+  }
+
+  if (timing)
+    tp_get_stats(tpool, &stats->tp);
+
+  free(visits);
+  free(repeat);
+  free(jobs);
+  free(wg.out_off);
+  free(wg.out_idx);
+  return 0;
+}
+
+void montecarlo_report(FILE *f, int N, int dead_end, long arcs,
+                       const montecarlo_result_t *r, const double *X,
+                       const double *se, int K, const int *top) {
+  double ranks_sum = 0;
+  for (int i = 0; i < N; i++)
+    ranks_sum += X[i];
+
+  fprintf(f, "Number of nodes: %d\n", N);
+  fprintf(f, "Number of dead-end nodes: %d\n", dead_end);
+  fprintf(f, "Number of valid arcs: %ld\n", arcs);
+  fprintf(f, "Monte Carlo estimate from %ld walks (%ld steps)\n", r->walks,
+          r->steps);
+  fprintf(f, "Sum of ranks: %0.4f   (should be 1)\n", ranks_sum);
+  if (K <= N) {
+    fprintf(f, "Top %d nodes (95%% confidence interval):\n", K);
+    for (int i = 0; i < K; i++) {
+      fprintf(f, "  %d %lf +- %lf\n", top[i], X[top[i]], 1.96 * se[top[i]]);
+    }
+  }
+}
+
+void montecarlo_free(montecarlo_result_t *result) {
+  if (result == NULL)
+    return;
+  free(result->ranks);
+  free(result->se);
+  result->ranks = NULL;
+  result->se = NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include "graph.h"
+#include "stats.h"
+#include "threadpool.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Stima del PageRank con cammini casuali ("complete path"): ogni cammino
+// parte da un nodo, a ogni passo continua con probabilità d verso un vicino
+// uscente a caso (da un dead-end verso un nodo qualsiasi) e si ferma con
+// probabilità 1 - d. Il rank di j è la frazione di tutte le visite che
+// cadono su j, cioè le visite medie a j per cammino divise per la lunghezza
+// media misurata dei cammini (attesa 1 / (1 - d)): la stima somma a 1. I
+// nodi con rank alto emergono con pochi cammini per nodo, molto prima che
+// l'iterazione arrivi a eps.
+
+typedef struct {
+  double d;      // Damping factor
+  long walks;    // Cammini totali, partono a turno da ogni nodo
+  uint64_t seed; // Seme dei generatori, uno per lavoro del pool
+  int isolated;  // Come pagerank_params_t.isolated
+} montecarlo_params_t;
+
+typedef struct {
+  double *ranks; // g->N elementi (+1 con isolated, come pagerank_run)
+  double *se;    // Errore standard di ogni rank, stessa lunghezza
+  long walks;
+  long steps; // Nodi visitati in tutto
+} montecarlo_result_t;
+
+// Esegue i cammini sul thread pool. Il risultato va liberato con
+// montecarlo_free. I generatori dipendono solo da seed e dall'indice del
+// lavoro, quindi il risultato non dipende dal numero di thread
+int pagerank_montecarlo(grafo *g, const montecarlo_params_t *params,
+                        thread_pool_t *tpool, montecarlo_result_t *result,
+                        stats_t *stats);
+
+// Report come pagerank_report, con cammini al posto delle iterazioni e
+// l'intervallo di confidenza al 95% dei primi K. X e se sono negli id di top
+void montecarlo_report(FILE *f, int N, int dead_end, long arcs,
+                       const montecarlo_result_t *r, const double *X,
+                       const double *se, int K, const int *top);
+
+void montecarlo_free(montecarlo_result_t *result);
+
+#endif // MONTECARLO_H
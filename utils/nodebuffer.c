@@ -53,3 +53,50 @@ tupla buffer_consume(buffer_t *buffer) {
 
   return item;
 }
+
+void buffer_produce_batch(buffer_t *buffer, const tupla *items, int n) {
+  while (n > 0) {
+    int chunk = n < buffer->size ? n : buffer->size;
+    for (int i = 0; i < chunk; i++)
+      sem_wait(&buffer->empty);
+
+    pthread_mutex_lock(&buffer->mutex);
+    for (int i = 0; i < chunk; i++) {
+      buffer->buffer[buffer->in] = items[i];
+      buffer->in = (buffer->in + 1) % buffer->size;
+    }
+    pthread_mutex_unlock(&buffer->mutex);
+
+    for (int i = 0; i < chunk; i++)
+      sem_post(&buffer->full);
+    items += chunk;
+    n -= chunk;
+  }
+}
+
+int buffer_consume_batch(buffer_t *buffer, tupla *items, int max) {
+  // Un permesso di full per ogni elemento che si vuole prelevare
+  sem_wait(&buffer->full);
+  int reserved = 1;
+  while (reserved < max && sem_trywait(&buffer->full) == 0)
+    reserved++;
+
+  pthread_mutex_lock(&buffer->mutex);
+  int taken = 0;
+  while (taken < reserved) {
+    tupla item = buffer->buffer[buffer->out];
+    buffer->out = (buffer->out + 1) % buffer->size;
+    items[taken++] = item;
+    if (item.IN == -1 && item.OUT == -1)
+      break;
+  }
+  pthread_mutex_unlock(&buffer->mutex);
+
+  // Gli elementi dopo il terminatore restano agli altri consumer
+  for (int i = taken; i < reserved; i++)
+    sem_post(&buffer->full);
+  for (int i = 0; i < taken; i++)
+    sem_post(&buffer->empty);
+
+  return taken;
+}
@@ -32,4 +32,13 @@ void buffer_produce(buffer_t *buffer, tupla item);
 // Rimuove un elemento dal buffer
 tupla buffer_consume(buffer_t *buffer);
 
+// Aggiunge n elementi prendendo il lock una volta ogni blocco
+void buffer_produce_batch(buffer_t *buffer, const tupla *items, int n);
+
+// Preleva fino a max elementi già presenti (almeno uno, attende se vuoto) e
+// ritorna quanti ne ha presi. Si ferma dopo una tupla (-1, -1), così ogni
+// consumer riceve il proprio terminatore. A differenza di buffer_consume non
+// termina il thread
+int buffer_consume_batch(buffer_t *buffer, tupla *items, int max);
+
 #endif // BUFFER_H
@@ -2,14 +2,16 @@
 #include "graph.h"
 #include "threadpool.h"
 #include <bits/pthreadtypes.h>
+#include <errno.h>
+#include <math.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-static bool signal_received = false;
-
 double first_term(grafo *g, double d) {
   double numeratore = 1 - d;
   double denominatore = (float)g->N;
@@ -18,24 +20,13 @@ double first_term(grafo *g, double d) {
   return calcolo;
 }
 
-typedef struct first_term_args {
-  grafo *g;
-  double d;
-  double *res;
-} first_term_args_t;
-
-void first_term_thread(void *arg) {
-  first_term_args_t *args = (first_term_args_t *)arg;
-  *(args->res) = first_term(args->g, args->d);
-}
-
 double second_term(grafo *g, int node, double d, double *Y) {
   double sum_in_node = 0;
 
-  int *arr = g->in->edges_array[node]->array;
-  int size = g->in->edges_array[node]->edges_num;
+  int *arr = &g->in_idx[g->in_off[node]];
+  long size = g->in_off[node + 1] - g->in_off[node];
 
-  for (int i = 0; i < size; i++) {
+  for (long i = 0; i < size; i++) {
     sum_in_node += Y[arr[i]]; // Qua posso fare direttamente prima il calcolo
                               // senza calcolare Y
                               // (Valido non usare Y)?
@@ -44,19 +35,6 @@ double second_term(grafo *g, int node, double d, double *Y) {
   return sum_in_node * d;
 }
 
-typedef struct second_term_args {
-  grafo *g;
-  int node;
-  double d;
-  double *Y;
-  double *res;
-} second_term_args_t;
-
-void second_term_thread(void *arg) {
-  second_term_args_t *args = (second_term_args_t *)arg;
-  *(args->res) = second_term(args->g, args->node, args->d, args->Y);
-}
-
 double third_term(grafo *g, double d, double S) {
   double res = d / (float)g->N;
 
@@ -76,17 +54,6 @@ double calcolo_S(grafo *g, double *X) {
   return sum;
 }
 
-typedef struct calc_S_args {
-  grafo *g;
-  double *X;
-  double *res;
-} calc_S_args_t;
-
-void calcolo_S_thread(void *arg) {
-  calc_S_args_t *args = (calc_S_args_t *)arg;
-  *(args->res) = calcolo_S(args->g, args->X);
-}
-
 void calcolo_Y(grafo *g, double *X, double *Y) {
   for (int i = 0; i < g->N; i++) {
     if (!g->out[i])
@@ -95,17 +62,6 @@ void calcolo_Y(grafo *g, double *X, double *Y) {
   }
 }
 
-typedef struct calc_Y_args {
-  grafo *g;
-  double *X;
-  double *res;
-} calc_Y_args_t;
-
-void calcolo_Y_thread(void *arg) {
-  calc_Y_args_t *args = (calc_Y_args_t *)arg;
-  calcolo_Y(args->g, args->X, args->res);
-}
-
 void calcolo_errore(grafo *g, double *X_t, double *X_t_1, double *err) {
   double temp = 0;
   // RAM
@@ -119,19 +75,6 @@ void calcolo_errore(grafo *g, double *X_t, double *X_t_1, double *err) {
   }
 }
 
-typedef struct calc_errore_args {
-  grafo *g;
-  double *X_t;
-  double *X_t_1;
-  double *res;
-} calc_errore_args_t;
-
-void calcolo_errore_thread(void *arg) {
-  calc_errore_args_t *args = (calc_errore_args_t *)arg;
-
-  calcolo_errore(args->g, args->X_t, args->X_t_1, args->res);
-}
-
 double calcolo_X_j_t_1(grafo *g, double d, int node, double *X, double *Y,
                        double S) {
   double first = first_term(g, d);
@@ -141,167 +84,637 @@ double calcolo_X_j_t_1(grafo *g, double d, int node, double *X, double *Y,
   return first + second + third;
 }
 
-typedef struct calcolo_args {
+// Vero se il nodo a precede b in classifica: rank maggiore o, a parità di
+// rank, id minore
+static bool rank_before(const double *X, int a, int b) {
+  return X[a] > X[b] || (X[a] == X[b] && a < b);
+}
+
+// Ripristina il min-heap (radice = peggiore in classifica) dalla posizione i
+static void heap_down(const double *X, int *heap, int n, int i) {
+  while (true) {
+    int l = 2 * i + 1;
+    int r = l + 1;
+    int worst = i;
+    if (l < n && rank_before(X, heap[worst], heap[l]))
+      worst = l;
+    if (r < n && rank_before(X, heap[worst], heap[r]))
+      worst = r;
+    if (worst == i)
+      return;
+    int t = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = t;
+    i = worst;
+  }
+}
+
+// Primi k tra gli n candidati in ordine di classifica: cand[i], oppure
+// start + i se cand è NULL. Ritorna min(k, n)
+static int select_top(const double *X, const int *cand, int start, int n,
+                      int k, int *idx) {
+  if (k > n)
+    k = n;
+  if (k <= 0)
+    return 0;
+
+  for (int i = 0; i < k; i++)
+    idx[i] = cand != NULL ? cand[i] : start + i;
+  for (int i = k / 2 - 1; i >= 0; i--)
+    heap_down(X, idx, k, i);
+
+  for (int i = k; i < n; i++) {
+    int v = cand != NULL ? cand[i] : start + i;
+    if (rank_before(X, v, idx[0])) {
+      idx[0] = v;
+      heap_down(X, idx, k, 0);
+    }
+  }
+
+  // Estrae il peggiore e lo mette in fondo: l'array finisce ordinato
+  for (int n = k - 1; n > 0; n--) {
+    int t = idx[0];
+    idx[0] = idx[n];
+    idx[n] = t;
+    heap_down(X, idx, n, 0);
+  }
+
+  return k;
+}
+
+// Intervallo di nodi [start, end) elaborato da un singolo lavoro del pool.
+// Gli argomenti sono allocati una volta sola e riusati ad ogni iterazione
+typedef struct chunk_args {
   grafo *g;
+  int start;
+  int end;
   double d;
-  int node;
-  double *Y;
   double first;
   double third;
-  double *res;
-} calcolo_args_t;
-
-void calcolo_X_j_t_1_thread(void *arg) {
-  calcolo_args_t *args = (calcolo_args_t *)arg;
-
-  double second = second_term(args->g, args->node, args->d, args->Y);
+  double *X_t;
+  double *X_t_1;
+  double *Y;
+  const double *inject; // Sistema ridotto, altrimenti NULL
+  const double *omega;
+  const double *rho;
+  double mass;  // Sistema ridotto: massa parziale del grafo intero
+  double scale; // Sistema ridotto: 1 / massa, applicato nella riduzione
+  double S;     // Somma parziale dei nodi dead-end
+  double err; // Errore parziale
+  int *top;   // Primi top_k nodi dell'intervallo, se serve la classifica
+  int top_k;
+  int top_n;
+} chunk_args_t;
+
+// Calcola X(t+1) per i nodi dell'intervallo
+void calcolo_chunk_thread(void *arg) {
+  chunk_args_t *c = (chunk_args_t *)arg;
+
+  if (c->inject != NULL) {
+    double uniform = c->first + c->third;
+    double S = 0;
+    double mass = 0;
+    for (int j = c->start; j < c->end; j++) {
+      double x = uniform * c->inject[j] + second_term(c->g, j, c->d, c->Y);
+      c->X_t_1[j] = x;
+      S += c->omega[j] * x;
+      mass += (1 + c->rho[j]) * x;
+    }
+    c->S = S;
+    c->mass = mass;
+    return;
+  }
 
-  *(args->res) = args->first + second + args->third;
-  free(args);
+  for (int j = c->start; j < c->end; j++) {
+    c->X_t_1[j] = c->first + second_term(c->g, j, c->d, c->Y) + c->third;
+  }
 }
 
-void handle_sigusr1() { signal_received = true; }
+// Dopo lo scambio X_t contiene i nuovi valori e X_t_1 i precedenti:
+// calcola S ed errore parziali e aggiorna Y per i nodi dell'intervallo
+void riduzione_chunk_thread(void *arg) {
+  chunk_args_t *c = (chunk_args_t *)arg;
+  int *out = c->g->out;
+  double S = 0;
+  double err = 0;
+
+  for (int i = c->start; i < c->end; i++) {
+    // Nel sistema ridotto il nucleo non ha dead-end: la loro massa passa da
+    // omega
+    if (c->omega != NULL) {
+      c->X_t[i] *= c->scale;
+      S += c->omega[i] * c->X_t[i];
+    }
+    if (!out[i]) {
+      S += c->X_t[i];
+    } else {
+      c->Y[i] = c->X_t[i] / (float)out[i];
+    }
+
+    double temp = c->X_t[i] - c->X_t_1[i];
+    if (temp < 0)
+      temp = -temp;
+    err += temp;
+  }
 
-void *sigusr1_thread(void *arg) {
+  c->S = S;
+  c->err = err;
 
-  int sig;
+  if (c->top != NULL)
+    c->top_n = select_top(c->X_t, NULL, c->start, c->end - c->start,
+                          c->top_k, c->top);
+}
 
-  // Faccio il setup del signal handler
-  struct sigaction sa;
-  sa.sa_handler = handle_sigusr1;
-  sa.sa_flags = 0;
-  sigemptyset(&sa.sa_mask);
-  sigaction(SIGUSR1, &sa, NULL);
+// SIGUSR1 resta bloccato in tutti i thread (main lo blocca prima di crearne)
+// e arriva qui con sigwait. Il primo nodo viene chiesto alla pagina delle
+// metriche: lo calcola la riduzione della prossima iterazione, divisa sui
+// worker, e senza richieste le iterazioni non fanno lavoro in più. A calcolo
+// finito (pagina in stato METRICS_DONE) il primo SIGUSR1 lo fa terminare
+static void *sigusr1_thread(void *arg) {
+  metrics_page_t *metrics = (metrics_page_t *)arg;
+  struct timespec poll = {.tv_sec = 0, .tv_nsec = 1000000};
 
-  // Sblocco SIGUSR1 in questo thread
+  int sig;
   sigset_t sigset;
   sigemptyset(&sigset);
   sigaddset(&sigset, SIGUSR1);
-  pthread_sigmask(SIG_UNBLOCK, &sigset, NULL);
 
   while (true) {
     sigwait(&sigset, &sig);
     if (sig == SIGUSR1) {
-      handle_sigusr1();
+      uint64_t req = metrics_request_top(metrics);
+      metrics_page_t snap;
+      metrics_read(metrics, &snap);
+      if (snap.state == METRICS_DONE)
+        return NULL;
+      while (snap.served < req && snap.state != METRICS_DONE) {
+        nanosleep(&poll, NULL);
+        metrics_read(metrics, &snap);
+      }
+      if (snap.top_node[0] >= 0)
+        fprintf(stderr, "%d %d %lf\n", snap.iteration, snap.top_node[0],
+                snap.top_rank[0]);
     }
   }
-
-  return NULL;
 }
 
-int find_max_array(double *X, int len) {
-  double max = -1;
-  int idx = 0;
+int pagerank_top_k(const double *X, int N, int k, int *idx) {
+  return select_top(X, NULL, 0, N, k, idx);
+}
 
-  for (int i = 0; i < len; i++) {
-    if (X[i] > max) {
-      max = X[i];
-      idx = i;
+void pagerank_report_values(FILE *f, int N, int dead_end, long arcs,
+                            double ranks_sum, int numiter, int maxiter,
+                            bool stable_stop, int K, const int *top,
+                            const double *top_rank) {
+  fprintf(f, "Number of nodes: %d\n", N);
+  fprintf(f, "Number of dead-end nodes: %d\n", dead_end);
+  fprintf(f, "Number of valid arcs: %ld\n", arcs);
+  if (stable_stop) {
+    fprintf(f, "Stopped on stable top %d after %d iterations\n", K, numiter);
+  } else if (numiter < maxiter) {
+    fprintf(f, "Converged after %d iterations\n", numiter);
+  } else {
+    fprintf(f, "Did not converge after %d iterations\n", maxiter);
+  }
+  fprintf(f, "Sum of ranks: %0.4f   (should be 1)\n", ranks_sum);
+  if (K <= N) {
+    fprintf(f, "Top %d nodes:\n", K);
+    for (int i = 0; i < K; i++) {
+      fprintf(f, "  %d %lf\n", top[i], top_rank[i]);
     }
   }
+}
+
+void pagerank_report(FILE *f, grafo *g, const double *X, int numiter,
+                     int maxiter, bool stable_stop, int K, const int *top) {
+  int dead_end = 0;
+  double ranks_sum = 0;
+  for (int i = 0; i < g->N; i++) {
+    if (g->out[i] == 0)
+      dead_end++;
+    ranks_sum += X[i];
+  }
+
+  int shown = K <= g->N ? K : 0;
+  double *top_rank = (double *)malloc((shown > 0 ? shown : 1) * sizeof(double));
+  for (int i = 0; i < shown; i++)
+    top_rank[i] = X[top[i]];
 
-  return idx;
+  pagerank_report_values(f, g->N, dead_end, grafo_arcs(g), ranks_sum, numiter,
+                         maxiter, stable_stop, K, top, top_rank);
+  free(top_rank);
 }
 
-double *pagerank(grafo *g, double d, double eps, int maxiter, int taux,
-                 int *numiter) {
+double pagerank_reduced_S(const pagerank_reduced_t *r, double d,
+                          double omega_sum) {
+  float nodes = (float)r->nodes;
+  return ((1 - d) * r->B / nodes + omega_sum) / (1 - d * r->B / nodes);
+}
+
+int pagerank_grain(int N, int threads) {
+  int chunks = threads * 4;
+  int grain = (N + chunks - 1) / chunks;
 
-  thread_pool_t *tpool;
-  tpool = tp_create(taux);
+  if (grain < 1024)
+    grain = 1024;
+
+  return grain;
+}
+
+// Classifica globale dai parziali dei chunk: i primi k di tutto il grafo
+// sono tra i primi k di qualche chunk. Ritorna il numero di nodi in top
+static int merge_top(const chunk_args_t *chunks, int chunks_num,
+                     const double *X, int k, int *cand, int *top) {
+  int n = 0;
+  for (int c = 0; c < chunks_num; c++) {
+    memcpy(cand + n, chunks[c].top, chunks[c].top_n * sizeof(int));
+    n += chunks[c].top_n;
+  }
+  return select_top(X, cand, 0, n, k, top);
+}
+
+// Vero se l'ordine dei primi k nodi di top (n >= k in tutto) non può più
+// cambiare: ogni rank dista al più bound dal punto fisso, quindi basta che
+// nodi consecutivi, compreso il k-esimo con il successivo, distino più di
+// 2 * bound
+static bool top_certain(const double *X, const int *top, int n, int k,
+                        double bound) {
+  int last = n > k ? k : k - 1;
+  for (int i = 0; i < last; i++) {
+    if (X[top[i]] - X[top[i + 1]] <= 2 * bound)
+      return false;
+  }
+  return true;
+}
+
+// Iterazioni che sarebbero servite per scendere sotto eps, supponendo che
+// l'errore continui a calare del rapporto rate per iterazione; mai oltre left,
+// le iterazioni che restavano fino a maxiter
+static int iterations_left(double err, double rate, double eps, int left) {
+  if (eps <= 0 || rate <= 0 || rate >= 1)
+    return left;
+  int n = (int)ceil(log(eps / err) / log(rate));
+  return n < left ? n : left;
+}
+
+int pagerank_arcs_bound(const grafo *g, int c, int chunks_num) {
+  if (c >= chunks_num)
+    return g->N;
+
+  // in_off[j] + j cresce con j; in_off può non partire da 0 (viste su
+  // componenti, vedi components.h)
+  long total = g->in_off[g->N] - g->in_off[0] + g->N;
+  long target = (long)((__int128)total * c / chunks_num);
+  int lo = 0;
+  int hi = g->N;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (g->in_off[mid] - g->in_off[0] + mid < target)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Esegue fn su tutti i chunk: sul thread pool, oppure in sequenza sul thread
+// chiamante se tpool è NULL
+static void run_chunks(thread_pool_t *tpool, thread_func_t fn,
+                       chunk_args_t *chunks, int chunks_num) {
+  if (tpool == NULL) {
+    for (int c = 0; c < chunks_num; c++)
+      fn(&chunks[c]);
+    return;
+  }
+
+  for (int c = 0; c < chunks_num; c++)
+    tp_add_work(tpool, fn, &chunks[c]);
+  tp_wait(tpool);
+}
+
+double *pagerank_run(grafo *g, const pagerank_params_t *params,
+                     thread_pool_t *tpool, int *numiter, stats_t *stats) {
+  double d = params->d;
+
+  bool timing = stats != NULL && stats->enabled;
+  if (timing)
+    tp_enable_stats(tpool);
 
   double *X_t = (double *)calloc(g->N, sizeof(double)); // X(t)
-  double *Y = (double *)calloc(g->N, sizeof(double));
-  double *X_t_1 = (double *)calloc(g->N, sizeof(double)); // X(t+1)
-  double *S = (double *)calloc(1, sizeof(double));
-  double *errore = (double *)calloc(1, sizeof(double));
-  double first = first_term(g, d);
+  double *Y;
+  double *X_t_1; // X(t+1)
+  pagerank_workspace_t *ws = params->ws;
+  if (ws != NULL) {
+    // Y viene scritto prima di essere letto e X(t+1) ad ogni iterazione:
+    // i valori rimasti dal grafo precedente non contano
+    if (ws->Y_cap < g->N) {
+      free(ws->Y);
+      ws->Y = (double *)malloc(g->N * sizeof(double));
+      ws->Y_cap = g->N;
+    }
+    if (ws->X_cap < g->N) {
+      free(ws->X);
+      ws->X = (double *)malloc(g->N * sizeof(double));
+      ws->X_cap = g->N;
+    }
+    Y = ws->Y;
+    X_t_1 = ws->X;
+  } else {
+    Y = (double *)calloc(g->N, sizeof(double));
+    X_t_1 = (double *)calloc(g->N, sizeof(double));
+  }
+  int X_t_cap = g->N; // Capacità del vettore allocato qui, per il workspace
+  double S;
+  double errore;
   double *temp;
+  int *temp_top;
+
+  // I nodi isolati fuori da g contano nel numero di nodi e, essendo
+  // dead-end senza archi entranti, valgono tutti first + third
+  const pagerank_reduced_t *reduced = params->reduced;
+  int isolated = reduced != NULL ? 0 : params->isolated;
+  float nodes = (float)(reduced != NULL ? reduced->nodes : g->N + isolated);
+  double first = (1 - d) / nodes;
+  double X_iso = 1.0 / nodes;
 
   for (int i = 0; i < g->N; i++)
-    X_t[i] = 1.0 / (float)g->N;
+    X_t[i] = 1.0 / nodes;
 
   calcolo_Y(g, X_t, Y); // Y(t)
 
-  *S = calcolo_S(g, X_t);
+  if (reduced != NULL) {
+    double omega_sum = 0;
+    for (int i = 0; i < g->N; i++)
+      omega_sum += reduced->omega[i] * X_t[i];
+    S = pagerank_reduced_S(reduced, d, omega_sum);
+  } else {
+    S = calcolo_S(g, X_t) + isolated * X_iso;
+  }
   int iter = 0;
 
-  calc_S_args_t *calc_S = (calc_S_args_t *)calloc(1, sizeof(calc_S_args_t));
-  calc_Y_args_t *calc_Y = (calc_Y_args_t *)calloc(1, sizeof(calc_Y_args_t));
-  calc_errore_args_t *calc_errore =
-      (calc_errore_args_t *)calloc(1, sizeof(calc_errore_args_t));
+  // Senza pool un solo chunk, salvo grain esplicito
+  int grain = params->grain;
+  int width = tpool != NULL ? tpool->thread_counter : 1;
+  if (params->width > 0 && params->width < width)
+    width = params->width;
+  if (grain <= 0)
+    grain = tpool != NULL ? pagerank_grain(g->N, width) : (g->N > 0 ? g->N : 1);
+
+  // Con una larghezza ridotta un lavoro per thread: più lavori che width
+  // occuperebbero anche gli altri worker
+  int chunks_num = (g->N + grain - 1) / grain;
+  if (tpool != NULL && width < tpool->thread_counter && chunks_num > width) {
+    grain = (g->N + width - 1) / width;
+    chunks_num = (g->N + grain - 1) / grain;
+  }
+  chunk_args_t *chunks =
+      (chunk_args_t *)calloc(chunks_num, sizeof(chunk_args_t));
+
+  for (int c = 0; c < chunks_num; c++) {
+    chunks[c].g = g;
+    if (params->balance_arcs) {
+      chunks[c].start = pagerank_arcs_bound(g, c, chunks_num);
+      chunks[c].end = pagerank_arcs_bound(g, c + 1, chunks_num);
+    } else {
+      chunks[c].start = c * grain;
+      chunks[c].end = (c + 1) * grain < g->N ? (c + 1) * grain : g->N;
+    }
+    chunks[c].d = d;
+    chunks[c].first = first;
+    chunks[c].Y = Y;
+    if (reduced != NULL) {
+      chunks[c].inject = reduced->inject;
+      chunks[c].omega = reduced->omega;
+      chunks[c].rho = reduced->rho;
+    }
+  }
 
-  // Parte segnali
-  pthread_t signal_thread;
-  pthread_create(&signal_thread, NULL, sigusr1_thread, NULL);
+  // Arresto sulla classifica: ogni chunk seleziona i propri primi k + 1
+  // nodi durante la riduzione, il k + 1-esimo serve per la distanza dal
+  // primo escluso
+  // La pagina delle metriche riceve i primi top_k nodi dalla stessa selezione
+  metrics_page_t *metrics = params->metrics;
+  bool stable_track = params->stable_k > 0 && params->stable_iters > 0;
+  int track = stable_track ? params->stable_k + 1 : 0;
+  if (metrics != NULL && metrics->top_k > track)
+    track = metrics->top_k;
+  int *cand = NULL;
+  int *top_now = NULL;
+  int *top_prev = NULL;
+  if (track > 0) {
+    for (int c = 0; c < chunks_num; c++) {
+      chunks[c].top = (int *)malloc(track * sizeof(int));
+      chunks[c].top_k = track;
+    }
+    cand = (int *)malloc((size_t)chunks_num * track * sizeof(int));
+    top_now = (int *)malloc(track * sizeof(int));
+    top_prev = (int *)malloc(track * sizeof(int));
+  }
+  int stable = 0;
+  bool stable_stop = false;
+  double first_err = 0;
+
+  double run_start = 0;
+  if (metrics != NULL) {
+    metrics_begin(metrics, g->N + isolated, grafo_arcs(g), params->maxiter,
+                  tpool != NULL ? tpool->thread_counter : 0);
+    tp_set_metrics(tpool, metrics);
+    run_start = stats_now();
+  }
 
   do {
-    double third = third_term(g, d, *S);
-
-    for (int j = 0; j < g->N; j++) {
-      calcolo_args_t *calc =
-          (calcolo_args_t *)calloc(1, sizeof(calcolo_args_t));
-      calc->g = g;
-      calc->d = d;
-      calc->node = j;
-      calc->Y = Y;
-      calc->first = first;
-      calc->third = third;
-      calc->res = &X_t_1[j];
-      tp_add_work(tpool, calcolo_X_j_t_1_thread, calc);
+    double t_start = timing ? stats_now() : 0;
+
+    // Classifica dei chunk solo se serve in questa iterazione
+    bool due = metrics != NULL && metrics_top_due(metrics);
+    bool want_top = stable_track || due;
+    for (int c = 0; track > 0 && c < chunks_num; c++)
+      chunks[c].top_k = want_top ? track : 0;
+    double third = d / nodes * S;
+    double X_iso_next = first + third;
+
+    for (int c = 0; c < chunks_num; c++) {
+      chunks[c].third = third;
+      chunks[c].X_t_1 = X_t_1;
+    }
+    run_chunks(tpool, calcolo_chunk_thread, chunks, chunks_num);
+    double t_update = timing ? stats_now() : 0;
+
+    // Il nucleo non conserva la massa: quella del grafo intero, con i nodi
+    // tolti ricavati dai nuovi valori, viene riportata a 1 nella riduzione
+    if (reduced != NULL) {
+      double omega_sum = 0;
+      double mass = 0;
+      for (int c = 0; c < chunks_num; c++) {
+        omega_sum += chunks[c].S;
+        mass += chunks[c].mass;
+      }
+      double S_next = reduced->B * X_iso_next + omega_sum;
+      double m = (mass + reduced->A * d / nodes * S_next) /
+                 (1 - reduced->A * (1 - d) / nodes);
+      for (int c = 0; c < chunks_num; c++)
+        chunks[c].scale = 1 / m;
+      X_iso_next /= m;
     }
-
-    tp_wait(tpool);
-    // printf("Finito di aspettare iter: %d\n", iter);
 
     temp = X_t;
     X_t = X_t_1;
     X_t_1 = temp;
 
-    calc_S->g = g;
-    calc_S->X = X_t;
-    calc_S->res = S;
-    // S = calcolo_S(g, X_t);
+    for (int c = 0; c < chunks_num; c++) {
+      chunks[c].X_t = X_t;
+      chunks[c].X_t_1 = X_t_1;
+    }
+    run_chunks(tpool, riduzione_chunk_thread, chunks, chunks_num);
+
+    S = isolated * X_iso_next;
+    errore = isolated * fabs(X_iso_next - X_iso);
+    X_iso = X_iso_next;
+    for (int c = 0; c < chunks_num; c++) {
+      S += chunks[c].S;
+      errore += chunks[c].err;
+    }
+    // I nodi tolti valgono in funzione del c appena usato, già scalato
+    if (reduced != NULL)
+      S += reduced->B * X_iso_next;
+    iter++;
 
-    calc_Y->g = g;
-    calc_Y->X = X_t;
-    calc_Y->res = Y;
-    // Y = calcolo_Y(g, X_t);
+    if (timing) {
+      double t_end = stats_now();
+      iter_stats_t it = {.time = t_end - t_start,
+                         .x_update = t_update - t_start,
+                         .reduce = t_end - t_update,
+                         .error = errore};
+      stats_add_iter(stats, it);
+    }
 
-    calc_errore->g = g;
-    calc_errore->X_t = X_t;
-    calc_errore->X_t_1 = X_t_1;
-    calc_errore->res = errore;
+    int n = 0;
+    if (want_top)
+      n = merge_top(chunks, chunks_num, X_t, track, cand, top_now);
+    if (metrics != NULL)
+      metrics_publish(metrics, iter, errore, S, stats_now() - run_start,
+                      want_top ? top_now : NULL, n, X_t);
+
+    if (stable_track) {
+      int k = n < params->stable_k ? n : params->stable_k;
+      if (iter > 1 && memcmp(top_now, top_prev, k * sizeof(int)) == 0)
+        stable++;
+      else
+        stable = 0;
+      temp_top = top_prev;
+      top_prev = top_now;
+      top_now = temp_top;
+
+      // La mappa contrae la norma L1 di un fattore d: la distanza dal punto
+      // fisso è al più d / (1 - d) volte l'ultimo passo
+      double bound = d / (1 - d) * errore;
+      if (stable >= params->stable_iters && errore > params->eps &&
+          iter < params->maxiter && top_certain(X_t, top_prev, n, k, bound)) {
+        stable_stop = true;
+        if (stats != NULL) {
+          stats->stable_stop = true;
+          // Il ritmo è la media geometrica dei rapporti tra errori
+          // consecutivi su tutto il calcolo: l'ultimo rapporto da solo
+          // sovrastima il calo
+          double rate = pow(errore / first_err, 1.0 / (iter - 1));
+          stats->iters_saved = iterations_left(errore, rate, params->eps,
+                                               params->maxiter - iter);
+        }
+      }
+    }
+    if (iter == 1)
+      first_err = errore;
+
+  } while (!stable_stop && errore > params->eps && iter < params->maxiter);
+
+  if (metrics != NULL) {
+    // Una richiesta arrivata durante l'ultima iterazione vede il risultato, e
+    // il file resta con la classifica finale
+    if (metrics_top_due(metrics) || !metrics->on_demand) {
+      int n = pagerank_top_k(X_t, g->N, track, top_now);
+      metrics_publish(metrics, iter, errore, S, stats_now() - run_start,
+                      top_now, n, X_t);
+    }
+    tp_set_metrics(tpool, NULL);
+    metrics_end(metrics);
+  }
 
-    tp_add_work(tpool, calcolo_S_thread, calc_S);
-    tp_add_work(tpool, calcolo_Y_thread, calc_Y);
-    tp_add_work(tpool, calcolo_errore_thread, calc_errore);
+  if (track > 0) {
+    for (int c = 0; c < chunks_num; c++)
+      free(chunks[c].top);
+    free(cand);
+    free(top_now);
+    free(top_prev);
+  }
+  free(chunks);
+  if (ws != NULL) {
+    // Il risultato può essere il vettore del workspace: resta al chiamante e
+    // il workspace tiene l'altro
+    if (X_t == ws->X) {
+      ws->X = X_t_1;
+      ws->X_cap = X_t_cap;
+    }
+  } else {
+    free(X_t_1);
+    free(Y);
+  }
+  if (timing)
+    tp_get_stats(tpool, &stats->tp);
 
-    tp_wait(tpool);
-    // errore = calcolo_errore(g, X_t, X_t_1);
-    iter++;
+  *numiter = iter;
 
-    if (signal_received) {
-      signal_received = false;
-      int max = find_max_array(X_t, g->N);
-      fprintf(stderr, "%d %d %lf\n", iter, max, X_t[max]);
-    }
+  if (isolated > 0) {
+    X_t = (double *)realloc(X_t, (g->N + 1) * sizeof(double));
+    X_t[g->N] = X_iso;
+  }
+
+  return X_t;
+}
 
-  } while (*errore > eps && iter < maxiter);
+void pagerank_workspace_free(pagerank_workspace_t *ws) {
+  free(ws->Y);
+  free(ws->X);
+  ws->Y = NULL;
+  ws->X = NULL;
+  ws->Y_cap = 0;
+  ws->X_cap = 0;
+}
 
-  pthread_cancel(signal_thread); // Mi serve, pure usando sig_atomic la sigwait
-                                 // sta in attesa e devo fare l'handling così
-  pthread_join(signal_thread, NULL);
+double *pagerank(grafo *g, double d, double eps, int maxiter, int taux,
+                 int *numiter, stats_t *stats) {
+  pagerank_params_t params = {
+      .d = d, .eps = eps, .maxiter = maxiter, .grain = 0};
+  return pagerank_with_params(g, &params, taux, numiter, stats);
+}
 
-  free(calc_S);
-  free(calc_Y);
-  free(calc_errore);
-  free(X_t_1);
-  free(Y);
-  free(S);
-  free(errore);
+double *pagerank_with_params(grafo *g, const pagerank_params_t *params,
+                             int taux, int *numiter, stats_t *stats) {
+  thread_pool_t *tpool = taux > 0 ? tp_create(taux) : NULL;
+  double *X = pagerank_run(g, params, tpool, numiter, stats);
   tp_destroy(tpool);
+  return X;
+}
 
-  *numiter = iter;
+int pagerank_signals_start(metrics_page_t *metrics, pthread_t *thread) {
+  // Il thread nasce con SIGUSR1 bloccato anche se il chiamante non lo
+  // blocca, così la sigwait riceve pure il segnale di uscita
+  sigset_t sigset, old;
+  sigemptyset(&sigset);
+  sigaddset(&sigset, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &sigset, &old);
+  int err = pthread_create(thread, NULL, sigusr1_thread, metrics);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
 
-  return X_t;
+void pagerank_signals_stop(metrics_page_t *metrics, pthread_t thread) {
+  // Di solito pagerank_run ha già segnato la pagina come finita; il segnale
+  // sveglia la sigwait e il thread esce da solo
+  metrics_end(metrics);
+  pthread_kill(thread, SIGUSR1);
+  pthread_join(thread, NULL);
 }
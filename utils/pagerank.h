@@ -1,4 +1,79 @@
+#ifndef PAGERANK_H
+#define PAGERANK_H
+
 #include "graph.h"
+#include "metrics.h"
+#include "stats.h"
+#include "threadpool.h"
+#include <stdio.h>
+
+// Sistema ridotto (vedi peel.h): g contiene solo il nucleo del grafo, i
+// nodi tolti entrano come coefficienti. Con c = (1 - d) / nodes + d S / nodes
+// il nodo j vale c * inject[j] + d * somma dei Y entranti, la massa dei
+// dead-end del grafo intero è S = B * c + somma di omega[i] * X[i] e la massa
+// totale è A * c + somma di (1 + rho[i]) * X[i]. Il nucleo da solo non
+// conserva la massa: pagerank_run la riporta a 1 ad ogni iterazione, come il
+// metodo delle potenze, altrimenti la convergenza rallenta fino a d
+typedef struct {
+  int nodes; // N del grafo intero
+  const double *inject;
+  const double *omega;
+  const double *rho;
+  double B;
+  double A;
+} pagerank_reduced_t;
+
+// Vettori di lavoro di pagerank_run tenuti tra un'esecuzione e l'altra:
+// grafi non più grandi del precedente non riallocano nulla. Va azzerato
+// prima del primo uso e liberato con pagerank_workspace_free
+typedef struct {
+  double *Y;
+  int Y_cap;
+  double *X; // Vettore che non è diventato il risultato
+  int X_cap;
+} pagerank_workspace_t;
+
+// Parametri di una esecuzione di pagerank_run
+typedef struct {
+  double d;    // Damping factor
+  double eps;  // Errore massimo
+  int maxiter; // Numero massimo di iterazioni
+  int grain;   // Nodi per lavoro del thread pool, 0 = automatico
+
+  // Thread del pool che il calcolo può tenere occupati: i lavori per
+  // iterazione sono al più width, così un pool condiviso o più grande del
+  // necessario non viene usato per intero. 0 = tutti
+  int width;
+
+  // Variante del kernel: i lavori hanno lo stesso numero di nodi più archi
+  // entranti invece dello stesso numero di nodi (grain fissa solo quanti
+  // sono). Serve con gradi molto sbilanciati
+  bool balance_arcs;
+
+  // Arresto anticipato sulla classifica: si ferma quando i primi stable_k
+  // nodi restano nello stesso ordine per stable_iters iterazioni e le
+  // distanze tra i loro rank superano l'errore residuo. 0 = solo errore L1
+  int stable_k;
+  int stable_iters;
+
+  // Nodi senza archi esclusi da g (vedi compact.h): contano in N e nella
+  // massa dei dead-end con un unico rank comune, che pagerank_run mette in
+  // fondo al vettore (g->N + 1 elementi). 0 = nessuno
+  int isolated;
+
+  // Se non NULL g è il nucleo di un sistema ridotto; isolated va lasciato a
+  // 0, i nodi isolati sono già compresi in B
+  const pagerank_reduced_t *reduced;
+
+  // Se non NULL Y e X(t + 1) vengono presi da qui invece che allocati. Un
+  // workspace va usato da una sola esecuzione alla volta
+  pagerank_workspace_t *ws;
+
+  // Se non NULL riceve ad ogni iterazione errore, massa dei dead-end, archi
+  // al secondo e i primi metrics->top_k nodi (vedi metrics.h); i worker del
+  // pool vi sommano il proprio tempo di lavoro
+  metrics_page_t *metrics;
+} pagerank_params_t;
 
 double first_term(grafo *g, double d);
 double second_term(grafo *g, int node, double d, double *Y);
@@ -8,5 +83,66 @@ void calcolo_Y(grafo *g, double *X, double *Y);
 void calcolo_errore(grafo *g, double *X_t, double *X_t_1, double *err);
 double calcolo_X_j_t_1(grafo *g, double d, int node, double *X, double *Y,
                        double S);
+// Seleziona i k nodi con rank più alto in ordine decrescente (a parità di
+// rank prima l'id minore) in O(N log k). Ritorna min(k, N)
+int pagerank_top_k(const double *X, int N, int k, int *idx);
+
+// Stampa il report finale: conteggi, convergenza, somma dei rank e, se
+// K <= N, i primi K nodi di top (calcolati con pagerank_top_k). stable_stop
+// se il calcolo si è fermato sulla classifica stabile (stats->stable_stop):
+// l'errore è ancora sopra eps e il report non parla di convergenza
+void pagerank_report(FILE *f, grafo *g, const double *X, int numiter,
+                     int maxiter, bool stable_stop, int K, const int *top);
+
+// Come pagerank_report, con conteggi e rank dei primi K già calcolati:
+// top_rank[i] è il rank del nodo top[i]
+void pagerank_report_values(FILE *f, int N, int dead_end, long arcs,
+                            double ranks_sum, int numiter, int maxiter,
+                            bool stable_stop, int K, const int *top,
+                            const double *top_rank);
+
+// S del sistema ridotto dalla somma omega_sum di omega[i] * X[i]: S compare
+// anche in c, quindi si risolve l'equazione S = B * c(S) + omega_sum
+double pagerank_reduced_S(const pagerank_reduced_t *r, double d,
+                          double omega_sum);
+
+void pagerank_workspace_free(pagerank_workspace_t *ws);
+
+// Nodi per lavoro di default con threads thread nel pool
+int pagerank_grain(int N, int threads);
+
+// Primo nodo del lavoro c di chunks_num con la variante balance_arcs: il
+// primo j con nodi più archi entranti prima di j >= c / chunks_num del totale
+int pagerank_arcs_bound(const grafo *g, int c, int chunks_num);
+
+// Nodi più archi fino ai quali il calcolo conviene in sequenza: sotto questa
+// soglia le due attese del pool per iterazione costano più di quanto rende
+// dividere il lavoro
+#define PAGERANK_SEQUENTIAL_WORK (1 << 17)
+
+// Esegue il calcolo sul thread pool passato, che resta attivo per altre
+// esecuzioni; con tpool NULL lo esegue sul thread chiamante. Ritorna il
+// vettore dei rank allocato con malloc. Con l'arresto sulla classifica stats
+// (se non NULL) riceve le iterazioni risparmiate
+double *pagerank_run(grafo *g, const pagerank_params_t *params,
+                     thread_pool_t *tpool, int *numiter, stats_t *stats);
+
+// Crea un thread pool di taux thread ed esegue pagerank_run. stats può
+// essere NULL, altrimenti raccoglie i tempi per iterazione
 double *pagerank(grafo *g, double d, double eps, int maxiter, int taux,
-                 int *numiter);
+                 int *numiter, stats_t *stats);
+
+// Come pagerank, con tutti i parametri di pagerank_params_t. Con taux 0 non
+// crea il pool e il calcolo gira sul thread chiamante
+double *pagerank_with_params(grafo *g, const pagerank_params_t *params,
+                             int taux, int *numiter, stats_t *stats);
+
+// Thread dei segnali: a ogni SIGUSR1 stampa su stderr iterazione, primo nodo
+// e suo rank, chiesti alla pagina metrics che il calcolo aggiorna. Lo avvia
+// solo l'eseguibile, non chi usa la libreria. -1 con errno se non parte
+int pagerank_signals_start(metrics_page_t *metrics, pthread_t *thread);
+
+// Segna la pagina come finita e attende l'uscita del thread
+void pagerank_signals_stop(metrics_page_t *metrics, pthread_t thread);
+
+#endif // PAGERANK_H
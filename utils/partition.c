@@ -0,0 +1,463 @@
+#include "partition.h"
+#include "decompress.h"
+#include "loader.h"
+#include "transport.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Partizione di un processo. I nodi posseduti occupano gli slot
+// [0, nloc), i nodi remoti referenziati dagli archi ("ghost") gli slot
+// [nloc, nloc + nghost) in ordine di id, quindi raggruppati per proprietario
+typedef struct {
+  transport_t *t;
+  int N;
+  int lo, hi, nloc;
+
+  long *in_off; // nloc + 1
+  int *in_idx; // Slot locali delle origini
+  long arcs;
+  int *out;    // Grado uscente globale dei nodi posseduti
+
+  int *ghost;     // Id globali dei ghost, ordinati
+  int nghost;
+  int *ghost_off; // I ghost del processo q sono ghost[ghost_off[q]...]
+
+  int **send_idx; // Slot locali richiesti da ogni processo
+  int *send_cnt;
+} part_t;
+
+// Archi letti dal file con destinazione nell'intervallo
+typedef struct {
+  int N, lo, hi;
+  int *src;
+  int *dst;
+  long n;
+  long cap;
+} edge_list_t;
+
+static int range_lo(int N, int procs, int q) {
+  return (int)((long)N * q / procs);
+}
+
+static void die(const char *msg) {
+  perror(msg);
+  exit(EXIT_FAILURE);
+}
+
+static void keep_edge(void *arg, int in, int out) {
+  edge_list_t *e = (edge_list_t *)arg;
+  if (out < e->lo || out >= e->hi || in >= e->N || in == out)
+    return;
+
+  if (e->n == e->cap) {
+    e->cap = e->cap ? e->cap * 2 : 4096;
+    e->src = (int *)realloc(e->src, e->cap * sizeof(int));
+    e->dst = (int *)realloc(e->dst, e->cap * sizeof(int));
+    if (e->src == NULL || e->dst == NULL)
+      die("Errore allocazione archi della partizione.");
+  }
+  e->src[e->n] = in;
+  e->dst[e->n] = out;
+  e->n++;
+}
+
+static int cmp_int(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+// Primo indice di v[0..n) con valore >= key
+static int lower_bound(const int *v, int n, int key) {
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (v[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Costruisce le liste entranti senza duplicati, l'insieme dei ghost e i
+// gradi uscenti parziali (archi verso i nodi posseduti da questo processo)
+static int *build_partition(part_t *p, edge_list_t *e) {
+  int size = p->t->size;
+
+  p->in_off = (long *)calloc(p->nloc + 1, sizeof(long));
+  int *in_idx = (int *)malloc((e->n > 0 ? e->n : 1) * sizeof(int));
+  if (p->in_off == NULL || in_idx == NULL)
+    die("Errore allocazione della partizione.");
+
+  // Ordinamento per conteggio sulla destinazione, come grafo_from_edges
+  for (long i = 0; i < e->n; i++)
+    p->in_off[e->dst[i] - p->lo + 1]++;
+  for (int j = 0; j < p->nloc; j++)
+    p->in_off[j + 1] += p->in_off[j];
+  long *cursor = (long *)malloc((p->nloc + 1) * sizeof(long));
+  memcpy(cursor, p->in_off, (p->nloc + 1) * sizeof(long));
+  for (long i = 0; i < e->n; i++)
+    in_idx[cursor[e->dst[i] - p->lo]++] = e->src[i];
+  free(cursor);
+  free(e->src);
+  free(e->dst);
+
+  long pos = 0;
+  long begin = 0;
+  for (int j = 0; j < p->nloc; j++) {
+    long end = p->in_off[j + 1];
+    qsort(&in_idx[begin], end - begin, sizeof(int), cmp_int);
+    p->in_off[j] = pos;
+    for (long k = begin; k < end; k++) {
+      if (k > begin && in_idx[k] == in_idx[k - 1])
+        continue;
+      in_idx[pos++] = in_idx[k];
+    }
+    begin = end;
+  }
+  p->in_off[p->nloc] = pos;
+  p->arcs = pos;
+
+  // Ghost: origini fuori dall'intervallo, ordinate e senza ripetizioni
+  p->ghost = (int *)malloc((pos > 0 ? pos : 1) * sizeof(int));
+  p->nghost = 0;
+  for (long k = 0; k < pos; k++) {
+    if (in_idx[k] < p->lo || in_idx[k] >= p->hi)
+      p->ghost[p->nghost++] = in_idx[k];
+  }
+  qsort(p->ghost, p->nghost, sizeof(int), cmp_int);
+  int unique = 0;
+  for (int k = 0; k < p->nghost; k++) {
+    if (k == 0 || p->ghost[k] != p->ghost[k - 1])
+      p->ghost[unique++] = p->ghost[k];
+  }
+  p->nghost = unique;
+
+  p->ghost_off = (int *)malloc((size + 1) * sizeof(int));
+  for (int q = 0; q <= size; q++)
+    p->ghost_off[q] = q == size ? p->nghost
+                                : lower_bound(p->ghost, p->nghost,
+                                              range_lo(p->N, size, q));
+
+  // Traduzione in slot locali e conteggio dei gradi uscenti parziali
+  int *partial = (int *)calloc(p->nloc + p->nghost + 1, sizeof(int));
+  for (long k = 0; k < pos; k++) {
+    int id = in_idx[k];
+    int slot = id >= p->lo && id < p->hi
+                   ? id - p->lo
+                   : p->nloc + lower_bound(p->ghost, p->nghost, id);
+    in_idx[k] = slot;
+    partial[slot]++;
+  }
+
+  p->in_idx = in_idx;
+  return partial;
+}
+
+// Scambio iniziale: ogni processo chiede ai proprietari i ghost che gli
+// servono e comunica loro quanti archi partono da ognuno, così ogni
+// proprietario completa il grado uscente dei propri nodi
+static void exchange_setup(part_t *p, int *partial) {
+  transport_t *t = p->t;
+  int size = t->size;
+
+  p->out = (int *)malloc((p->nloc > 0 ? p->nloc : 1) * sizeof(int));
+  memcpy(p->out, partial, p->nloc * sizeof(int));
+  p->send_idx = (int **)calloc(size, sizeof(int *));
+  p->send_cnt = (int *)calloc(size, sizeof(int));
+
+  for (int s = 1; s < size; s++) {
+    int to = (t->rank + s) % size;
+    int from = (t->rank - s + size) % size;
+
+    int nreq = p->ghost_off[to + 1] - p->ghost_off[to];
+    int nrecv = 0;
+    if (transport_sendrecv(t, to, &nreq, sizeof(int), from, &nrecv,
+                           sizeof(int)) != 0)
+      die("Errore scambio partizioni");
+
+    // Coppie (id, archi uscenti) per i ghost posseduti da to
+    int *req = (int *)malloc((2 * (size_t)nreq + 1) * sizeof(int));
+    int *got = (int *)malloc((2 * (size_t)nrecv + 1) * sizeof(int));
+    for (int k = 0; k < nreq; k++) {
+      req[2 * k] = p->ghost[p->ghost_off[to] + k];
+      req[2 * k + 1] = partial[p->nloc + p->ghost_off[to] + k];
+    }
+    if (transport_sendrecv(t, to, req, 2 * (size_t)nreq * sizeof(int), from,
+                           got, 2 * (size_t)nrecv * sizeof(int)) != 0)
+      die("Errore scambio partizioni");
+
+    p->send_cnt[from] = nrecv;
+    p->send_idx[from] = (int *)malloc((nrecv + 1) * sizeof(int));
+    for (int k = 0; k < nrecv; k++) {
+      int slot = got[2 * k] - p->lo;
+      p->send_idx[from][k] = slot;
+      p->out[slot] += got[2 * k + 1];
+    }
+
+    free(req);
+    free(got);
+  }
+}
+
+// Aggiorna gli Y dei ghost con i valori dei proprietari
+static void exchange_halo(part_t *p, double *Y, double *scratch) {
+  transport_t *t = p->t;
+  int size = t->size;
+
+  for (int s = 1; s < size; s++) {
+    int to = (t->rank + s) % size;
+    int from = (t->rank - s + size) % size;
+
+    for (int k = 0; k < p->send_cnt[to]; k++)
+      scratch[k] = Y[p->send_idx[to][k]];
+
+    double *dst = Y + p->nloc + p->ghost_off[from];
+    size_t rlen = (size_t)(p->ghost_off[from + 1] - p->ghost_off[from]) *
+                  sizeof(double);
+    if (transport_sendrecv(t, to, scratch,
+                           (size_t)p->send_cnt[to] * sizeof(double), from, dst,
+                           rlen) != 0)
+      die("Errore scambio contributi");
+  }
+}
+
+typedef struct {
+  int id;
+  double rank;
+} candidate_t;
+
+static int cmp_candidate(const void *a, const void *b) {
+  const candidate_t *x = (const candidate_t *)a;
+  const candidate_t *y = (const candidate_t *)b;
+  if (x->rank != y->rank)
+    return x->rank < y->rank ? 1 : -1;
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+// Ogni processo manda al rank 0 i propri primi K, che il rank 0 unisce
+static void report(part_t *p, const double *X, int numiter,
+                   const pagerank_params_t *params, int K, FILE *out) {
+  transport_t *t = p->t;
+
+  double totals[3] = {0, 0, (double)p->arcs}; // Rank, dead-end, archi
+  for (int i = 0; i < p->nloc; i++) {
+    totals[0] += X[i];
+    if (p->out[i] == 0)
+      totals[1]++;
+  }
+  if (transport_allreduce_sum(t, totals, 3) != 0)
+    die("Errore riduzione finale");
+
+  int *idx = (int *)malloc((K > 0 ? K : 1) * sizeof(int));
+  int local = pagerank_top_k(X, p->nloc, K, idx);
+  candidate_t *mine = (candidate_t *)malloc((local + 1) * sizeof(candidate_t));
+  for (int i = 0; i < local; i++)
+    mine[i] = (candidate_t){.id = idx[i] + p->lo, .rank = X[idx[i]]};
+  free(idx);
+
+  if (t->rank != 0) {
+    if (transport_send(t, 0, &local, sizeof(int)) != 0 ||
+        transport_send(t, 0, mine, local * sizeof(candidate_t)) != 0)
+      die("Errore invio dei primi K");
+    free(mine);
+    return;
+  }
+
+  int total = local;
+  candidate_t *all = mine;
+  for (int q = 1; q < t->size; q++) {
+    int n;
+    if (transport_recv(t, q, &n, sizeof(int)) != 0)
+      die("Errore ricezione dei primi K");
+    all = (candidate_t *)realloc(all, (total + n + 1) * sizeof(candidate_t));
+    if (transport_recv(t, q, all + total, n * sizeof(candidate_t)) != 0)
+      die("Errore ricezione dei primi K");
+    total += n;
+  }
+  qsort(all, total, sizeof(candidate_t), cmp_candidate);
+
+  int shown = K < total ? K : total;
+  int *top = (int *)malloc((shown + 1) * sizeof(int));
+  double *top_rank = (double *)malloc((shown + 1) * sizeof(double));
+  for (int i = 0; i < shown; i++) {
+    top[i] = all[i].id;
+    top_rank[i] = all[i].rank;
+  }
+
+  pagerank_report_values(out, p->N, (int)totals[1], (long)totals[2],
+                         totals[0], numiter, params->maxiter, false, K, top,
+                         top_rank);
+  fflush(out);
+
+  free(top);
+  free(top_rank);
+  free(all);
+}
+
+static void worker(transport_t *t, const char *filename,
+                   const pagerank_params_t *params, int K, FILE *out) {
+  FILE *src = fopen(filename, "r");
+  if (src == NULL)
+    die("Errore lettura file.");
+
+  // I processi sono già uno per core: decompressione in streaming
+  FILE *file;
+  decompressor_t *dec = decompress_open(src, 1, &file);
+
+  stream_header_t h;
+  part_t p = {.t = t};
+  p.N = file != NULL ? read_stream_header(file, &h) : -1;
+  if (p.N < 0)
+    die("Errore caricamento grafo");
+  p.lo = range_lo(p.N, t->size, t->rank);
+  p.hi = range_lo(p.N, t->size, t->rank + 1);
+  p.nloc = p.hi - p.lo;
+
+  edge_list_t e = {.N = p.N, .lo = p.lo, .hi = p.hi};
+  long edges_read = read_stream_edges(file, &h, keep_edge, &e);
+  if (decompress_close(dec) != 0 || edges_read < 0)
+    die("Errore caricamento grafo");
+  fclose(src);
+
+  int *partial = build_partition(&p, &e);
+  exchange_setup(&p, partial);
+  free(partial);
+
+  int max_send = 1;
+  for (int q = 0; q < t->size; q++)
+    max_send = p.send_cnt[q] > max_send ? p.send_cnt[q] : max_send;
+
+  double d = params->d;
+  double first = (1 - d) / (float)p.N;
+  double *X_t = (double *)malloc((p.nloc + 1) * sizeof(double));
+  double *X_t_1 = (double *)malloc((p.nloc + 1) * sizeof(double));
+  double *Y = (double *)calloc(p.nloc + p.nghost + 1, sizeof(double));
+  double *scratch = (double *)malloc(max_send * sizeof(double));
+
+  double sums[2] = {0, 0}; // S, errore
+  for (int i = 0; i < p.nloc; i++) {
+    X_t[i] = 1.0 / (float)p.N;
+    if (!p.out[i])
+      sums[0] += X_t[i];
+    else
+      Y[i] = X_t[i] / (float)p.out[i];
+  }
+  if (transport_allreduce_sum(t, sums, 1) != 0)
+    die("Errore riduzione");
+
+  int iter = 0;
+  double errore;
+  do {
+    exchange_halo(&p, Y, scratch);
+
+    double third = d / (float)p.N * sums[0];
+    for (int j = 0; j < p.nloc; j++) {
+      double sum_in_node = 0;
+      for (long k = p.in_off[j]; k < p.in_off[j + 1]; k++)
+        sum_in_node += Y[p.in_idx[k]];
+      X_t_1[j] = first + sum_in_node * d + third;
+    }
+
+    double *temp = X_t;
+    X_t = X_t_1;
+    X_t_1 = temp;
+
+    sums[0] = 0;
+    sums[1] = 0;
+    for (int i = 0; i < p.nloc; i++) {
+      if (!p.out[i])
+        sums[0] += X_t[i];
+      else
+        Y[i] = X_t[i] / (float)p.out[i];
+
+      double diff = X_t[i] - X_t_1[i];
+      sums[1] += diff < 0 ? -diff : diff;
+    }
+    if (transport_allreduce_sum(t, sums, 2) != 0)
+      die("Errore riduzione");
+    errore = sums[1];
+    iter++;
+  } while (errore > params->eps && iter < params->maxiter);
+
+  report(&p, X_t, iter, params, K, out);
+
+  for (int q = 0; q < t->size; q++)
+    free(p.send_idx[q]);
+  free(p.send_idx);
+  free(p.send_cnt);
+  free(p.ghost);
+  free(p.ghost_off);
+  free(p.in_off);
+  free(p.in_idx);
+  free(p.out);
+  free(X_t);
+  free(X_t_1);
+  free(Y);
+  free(scratch);
+}
+
+int pagerank_partitioned(const char *filename, const char *transport,
+                         int procs, const pagerank_params_t *params, int K,
+                         FILE *out) {
+  transport_t *t = transport_create(transport, procs);
+  if (t == NULL)
+    return -1;
+
+  pid_t *pids = (pid_t *)calloc(procs, sizeof(pid_t));
+  fflush(NULL); // I buffer di stdio non vanno duplicati nei figli
+
+  for (int r = 0; r < procs; r++) {
+    pids[r] = fork();
+    if (pids[r] < 0) {
+      perror("Errore fork");
+      for (int q = 0; q < r; q++)
+        kill(pids[q], SIGTERM);
+      procs = r;
+      break;
+    }
+    if (pids[r] == 0) {
+      transport_attach(t, r);
+      worker(t, filename, params, K, out);
+      transport_destroy(t);
+      free(pids);
+      exit(EXIT_SUCCESS);
+    }
+  }
+
+  // Il padre non partecipa al calcolo e rilascia i capi dei figli
+  transport_attach(t, -1);
+
+  // Se un processo fallisce gli altri resterebbero in attesa dei suoi dati
+  bool failed = procs < t->size;
+  for (int alive = procs; alive > 0; alive--) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0)
+      break;
+    for (int q = 0; q < procs; q++) {
+      if (pids[q] == pid)
+        pids[q] = 0;
+    }
+    if (!failed && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+      failed = true;
+      for (int q = 0; q < procs; q++) {
+        if (pids[q] > 0)
+          kill(pids[q], SIGTERM);
+      }
+    }
+  }
+
+  free(pids);
+  transport_destroy(t);
+  if (failed) {
+    errno = ECANCELED;
+    return -1;
+  }
+  return 0;
+}
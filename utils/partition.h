@@ -0,0 +1,18 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "pagerank.h"
+#include <stdio.h>
+
+// Calcolo partizionato su procs processi collegati dal trasporto transport
+// ("shm" o "unix", vedi transport.h). Ogni processo legge il file per conto
+// proprio e tiene solo l'intervallo di nodi che possiede, con i relativi
+// archi entranti; ad ogni iterazione riceve dagli altri solo i contributi Y
+// dei nodi di confine che compaiono nei suoi archi, mentre S ed errore
+// vengono sommati da tutti i processi. Il rank 0 scrive il report su out.
+// Ritorna 0, oppure -1 se un processo è fallito
+int pagerank_partitioned(const char *filename, const char *transport,
+                         int procs, const pagerank_params_t *params, int K,
+                         FILE *out);
+
+#endif // PARTITION_H
@@ -0,0 +1,265 @@
+#include "peel.h"
+#include <stdlib.h>
+
+enum { PEEL_CORE, PEEL_UPSTREAM, PEEL_DOWNSTREAM };
+
+// Nucleo con le sole liste entranti dai nodi del nucleo: i nodi a monte
+// entrano in inject, quelli a valle non hanno archi verso il nucleo
+static grafo *build_core(const grafo *g, const char *state, const int *ids,
+                         const int *index, int M) {
+  grafo *core = (grafo *)calloc(1, sizeof(grafo));
+  if (core == NULL)
+    return NULL;
+  core->N = M;
+  core->out = (int *)malloc((M > 0 ? M : 1) * sizeof(int));
+  core->in_off = (long *)malloc(((size_t)M + 1) * sizeof(long));
+
+  long arcs = 0;
+  for (int j = 0; j < M; j++) {
+    int v = ids[j];
+    for (long k = g->in_off[v]; k < g->in_off[v + 1]; k++)
+      arcs += state[g->in_idx[k]] == PEEL_CORE;
+  }
+  core->in_idx = (int *)malloc((arcs > 0 ? arcs : 1) * sizeof(int));
+  if (core->out == NULL || core->in_off == NULL || core->in_idx == NULL) {
+    free_grafo(core);
+    return NULL;
+  }
+
+  long pos = 0;
+  for (int j = 0; j < M; j++) {
+    int v = ids[j];
+    core->out[j] = g->out[v];
+    core->in_off[j] = pos;
+    for (long k = g->in_off[v]; k < g->in_off[v + 1]; k++) {
+      int i = g->in_idx[k];
+      if (state[i] == PEEL_CORE)
+        core->in_idx[pos++] = index[i];
+    }
+  }
+  core->in_off[M] = pos;
+  return core;
+}
+
+peel_t *peel_graph(const grafo *g, int isolated, double d) {
+  int N = g->N;
+  long *out_off;
+  int *out_idx;
+  if (grafo_out_lists(g, &out_off, &out_idx) != 0)
+    return NULL;
+
+  peel_t *p = (peel_t *)calloc(1, sizeof(peel_t));
+  char *state = (char *)calloc(N > 0 ? N : 1, sizeof(char));
+  int *deg = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+  double *mu = (double *)malloc((N > 0 ? N : 1) * sizeof(double));
+  double *nu = (double *)malloc((N > 0 ? N : 1) * sizeof(double));
+  int *index = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+  if (p != NULL) {
+    p->upstream = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+    p->downstream = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+    p->alpha = (double *)malloc((N > 0 ? N : 1) * sizeof(double));
+  }
+  if (p == NULL || state == NULL || deg == NULL || mu == NULL || nu == NULL ||
+      index == NULL || p->upstream == NULL || p->downstream == NULL ||
+      p->alpha == NULL) {
+    free(out_off);
+    free(out_idx);
+    free(state);
+    free(deg);
+    free(mu);
+    free(nu);
+    free(index);
+    peel_free(p);
+    return NULL;
+  }
+  p->g = g;
+  p->isolated = isolated;
+  p->d = d;
+
+  // A monte: la coda è anche l'ordine topologico
+  int *up = p->upstream;
+  int tail = 0;
+  for (int v = 0; v < N; v++) {
+    deg[v] = (int)(g->in_off[v + 1] - g->in_off[v]);
+    if (deg[v] == 0)
+      up[tail++] = v;
+  }
+  for (int head = 0; head < tail; head++) {
+    int u = up[head];
+    state[u] = PEEL_UPSTREAM;
+    for (long k = out_off[u]; k < out_off[u + 1]; k++) {
+      if (--deg[out_idx[k]] == 0)
+        up[tail++] = out_idx[k];
+    }
+  }
+  p->upstream_num = tail;
+
+  // alpha: ogni nodo riceve c, più quanto arriva dai nodi a monte, che sono
+  // già completi quando vengono visitati
+  for (int v = 0; v < N; v++)
+    p->alpha[v] = 1;
+  for (int h = 0; h < p->upstream_num; h++) {
+    int u = up[h];
+    if (g->out[u] == 0)
+      continue;
+    double share = d * p->alpha[u] / (float)g->out[u];
+    for (long k = out_off[u]; k < out_off[u + 1]; k++)
+      p->alpha[out_idx[k]] += share;
+  }
+
+  // A valle, tra i nodi rimasti: i successori di un nodo non a monte non
+  // sono mai a monte
+  int *down = p->downstream;
+  tail = 0;
+  for (int v = 0; v < N; v++) {
+    if (state[v] != PEEL_CORE)
+      continue;
+    deg[v] = (int)(out_off[v + 1] - out_off[v]);
+    if (deg[v] == 0)
+      down[tail++] = v;
+  }
+  for (int head = 0; head < tail; head++) {
+    int v = down[head];
+    state[v] = PEEL_DOWNSTREAM;
+    for (long k = g->in_off[v]; k < g->in_off[v + 1]; k++) {
+      int i = g->in_idx[k];
+      if (state[i] == PEEL_CORE && --deg[i] == 0)
+        down[tail++] = i;
+    }
+  }
+  p->downstream_num = tail;
+
+  // Per ciò che entra in un nodo a valle: mu è la quota che finisce nei
+  // dead-end, nu la massa che produce lungo la discesa. I successori vengono
+  // tolti prima, quindi sono già calcolati
+  for (int h = 0; h < p->downstream_num; h++) {
+    int v = down[h];
+    if (g->out[v] == 0) {
+      mu[v] = 1;
+      nu[v] = 1;
+      continue;
+    }
+    double sum_mu = 0;
+    double sum_nu = 0;
+    for (long k = out_off[v]; k < out_off[v + 1]; k++) {
+      sum_mu += mu[out_idx[k]];
+      sum_nu += nu[out_idx[k]];
+    }
+    mu[v] = d * sum_mu / (float)g->out[v];
+    nu[v] = 1 + d * sum_nu / (float)g->out[v];
+  }
+
+  // B e A: coefficienti di c nella massa dei dead-end e in quella totale
+  // dei nodi tolti
+  double B = isolated;
+  double A = isolated;
+  for (int h = 0; h < p->upstream_num; h++) {
+    if (g->out[up[h]] == 0)
+      B += p->alpha[up[h]];
+    A += p->alpha[up[h]];
+  }
+  for (int h = 0; h < p->downstream_num; h++) {
+    B += mu[down[h]] * p->alpha[down[h]];
+    A += nu[down[h]] * p->alpha[down[h]];
+  }
+
+  int M = N - p->upstream_num - p->downstream_num;
+  p->core_ids = (int *)malloc((M > 0 ? M : 1) * sizeof(int));
+  p->inject = (double *)malloc((M > 0 ? M : 1) * sizeof(double));
+  p->omega = (double *)malloc((M > 0 ? M : 1) * sizeof(double));
+  p->rho = (double *)malloc((M > 0 ? M : 1) * sizeof(double));
+  if (p->core_ids != NULL && p->inject != NULL && p->omega != NULL &&
+      p->rho != NULL) {
+    int j = 0;
+    for (int v = 0; v < N; v++) {
+      if (state[v] != PEEL_CORE)
+        continue;
+      double sum_mu = 0;
+      double sum_nu = 0;
+      for (long k = out_off[v]; k < out_off[v + 1]; k++) {
+        if (state[out_idx[k]] == PEEL_DOWNSTREAM) {
+          sum_mu += mu[out_idx[k]];
+          sum_nu += nu[out_idx[k]];
+        }
+      }
+      p->core_ids[j] = v;
+      p->inject[j] = p->alpha[v];
+      p->omega[j] = d * sum_mu / (float)g->out[v];
+      p->rho[j] = d * sum_nu / (float)g->out[v];
+      index[v] = j++;
+    }
+    p->core = build_core(g, state, p->core_ids, index, M);
+  }
+
+  free(out_off);
+  free(out_idx);
+  free(state);
+  free(deg);
+  free(mu);
+  free(nu);
+  free(index);
+  if (p->core == NULL) {
+    peel_free(p);
+    return NULL;
+  }
+
+  p->reduced = (pagerank_reduced_t){.nodes = N + isolated,
+                                    .inject = p->inject,
+                                    .omega = p->omega,
+                                    .rho = p->rho,
+                                    .B = B,
+                                    .A = A};
+  return p;
+}
+
+double *peel_expand(const peel_t *p, const double *X) {
+  const grafo *g = p->g;
+  double d = p->d;
+  int N = g->N;
+  int slots = N + (p->isolated > 0 ? 1 : 0);
+  double *full = (double *)malloc((slots > 0 ? slots : 1) * sizeof(double));
+  if (full == NULL)
+    return NULL;
+
+  // Termine uniforme dai rank finali del nucleo
+  double omega_sum = 0;
+  for (int j = 0; j < p->core->N; j++)
+    omega_sum += p->omega[j] * X[j];
+  double S = pagerank_reduced_S(&p->reduced, d, omega_sum);
+  float nodes = (float)p->reduced.nodes;
+  double c = (1 - d) / nodes + d / nodes * S;
+
+  for (int j = 0; j < p->core->N; j++)
+    full[p->core_ids[j]] = X[j];
+  for (int h = 0; h < p->upstream_num; h++)
+    full[p->upstream[h]] = p->alpha[p->upstream[h]] * c;
+
+  // All'indietro con l'equazione del PageRank: i predecessori a valle di un
+  // nodo sono stati tolti dopo, quindi sono già calcolati
+  for (int h = p->downstream_num - 1; h >= 0; h--) {
+    int v = p->downstream[h];
+    double sum = 0;
+    for (long k = g->in_off[v]; k < g->in_off[v + 1]; k++)
+      sum += full[g->in_idx[k]] / (float)g->out[g->in_idx[k]];
+    full[v] = c + d * sum;
+  }
+
+  if (p->isolated > 0)
+    full[N] = c;
+  return full;
+}
+
+void peel_free(peel_t *p) {
+  if (p == NULL)
+    return;
+  if (p->core != NULL)
+    free_grafo(p->core);
+  free(p->core_ids);
+  free(p->inject);
+  free(p->omega);
+  free(p->rho);
+  free(p->upstream);
+  free(p->alpha);
+  free(p->downstream);
+  free(p);
+}
@@ -0,0 +1,46 @@
+#ifndef PEEL_H
+#define PEEL_H
+
+#include "graph.h"
+#include "pagerank.h"
+
+// Riduzione del grafo prima del calcolo. Vengono tolti a ripetizione:
+//   - a monte: i nodi senza archi entranti, poi quelli raggiunti solo da
+//     nodi già tolti (alberi e catene che entrano nel nucleo). Il loro rank
+//     è alpha * c, con c il termine uniforme;
+//   - a valle: i dead-end, poi i nodi i cui archi uscenti portano solo a
+//     nodi già tolti (catene e alberi che finiscono in dead-end). Contano
+//     solo nella massa S, come combinazione lineare dei rank del nucleo.
+// L'iterazione gira sul nucleo rimasto (pagerank_reduced_t); alla fine i
+// rank dei nodi tolti si ricavano in un solo passaggio all'indietro.
+
+typedef struct {
+  const grafo *g;   // Grafo intero
+  int isolated;     // Nodi isolati fuori da g (compact.h)
+  double d;
+
+  grafo *core;      // Nucleo con id 0..core->N - 1, out = grado originale
+  int *core_ids;    // Id in g dei nodi del nucleo
+  double *inject;   // Per il sistema ridotto, core->N elementi
+  double *omega;
+  double *rho;
+  pagerank_reduced_t reduced;
+
+  int *upstream;    // Nodi tolti a monte, in ordine topologico
+  int upstream_num;
+  double *alpha;    // Coefficiente di c dei nodi di g (1 + parte a monte)
+  int *downstream;  // Nodi tolti a valle, nell'ordine in cui sono stati tolti
+  int downstream_num;
+} peel_t;
+
+// Calcola nucleo e coefficienti per damping d. NULL se manca memoria
+peel_t *peel_graph(const grafo *g, int isolated, double d);
+
+// Rank di tutti i nodi di g dai rank X del nucleo calcolati con
+// params.reduced = &p->reduced: g->N elementi, + 1 con nodi isolati (il loro
+// rank comune in fondo, come pagerank_run)
+double *peel_expand(const peel_t *p, const double *X);
+
+void peel_free(peel_t *p);
+
+#endif // PEEL_H
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+#include "rankdump.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Byte per scrittura: abbastanza grandi da essere sequenziali, abbastanza
+// piccoli da dividere il file tra tutti i thread
+#define RANK_DUMP_CHUNK (8 << 20)
+
+// Posizione di un array dopo l'intestazione, allineata a 8 byte
+static uint64_t align8(uint64_t n) { return (n + 7) / 8 * 8; }
+
+// Rank decrescente, a parità di rank id crescente
+static int order_cmp(const void *a, const void *b, void *arg) {
+  const double *X = (const double *)arg;
+  int i = *(const int *)a;
+  int j = *(const int *)b;
+  if (X[i] > X[j])
+    return -1;
+  if (X[i] < X[j])
+    return 1;
+  return (i > j) - (i < j);
+}
+
+// Ordinamento di un intervallo, poi fusione a coppie degli intervalli
+typedef struct {
+  const double *X;
+  int *src;
+  int *dst;
+  int lo, mid, hi;
+} sort_job_t;
+
+static void sort_run(void *arg) {
+  sort_job_t *j = (sort_job_t *)arg;
+  for (int i = j->lo; i < j->hi; i++)
+    j->src[i] = i;
+  qsort_r(j->src + j->lo, j->hi - j->lo, sizeof(int), order_cmp,
+          (void *)j->X);
+}
+
+static void merge_runs(void *arg) {
+  sort_job_t *j = (sort_job_t *)arg;
+  int a = j->lo, b = j->mid, o = j->lo;
+  while (a < j->mid && b < j->hi) {
+    if (order_cmp(&j->src[b], &j->src[a], (void *)j->X) < 0)
+      j->dst[o++] = j->src[b++];
+    else
+      j->dst[o++] = j->src[a++];
+  }
+  memcpy(j->dst + o, j->src + a, (j->mid - a) * sizeof(int));
+  o += j->mid - a;
+  memcpy(j->dst + o, j->src + b, (j->hi - b) * sizeof(int));
+}
+
+// Ordine dei nodi per rank. Ritorna l'array ordinato (order o tmp)
+static int *sort_order(const double *X, int N, int *order, int *tmp,
+                       thread_pool_t *tpool) {
+  int runs = tpool->thread_counter * 2;
+  if (runs > N)
+    runs = N > 0 ? N : 1;
+
+  int *bounds = (int *)malloc((runs + 1) * sizeof(int));
+  sort_job_t *jobs = (sort_job_t *)malloc(runs * sizeof(sort_job_t));
+  if (bounds == NULL || jobs == NULL) {
+    free(bounds);
+    free(jobs);
+    return NULL;
+  }
+  for (int r = 0; r <= runs; r++)
+    bounds[r] = (int)((long)N * r / runs);
+
+  for (int r = 0; r < runs; r++) {
+    jobs[r] = (sort_job_t){
+        .X = X, .src = order, .lo = bounds[r], .hi = bounds[r + 1]};
+    tp_add_work(tpool, sort_run, &jobs[r]);
+  }
+  tp_wait(tpool);
+
+  int *src = order;
+  int *dst = tmp;
+  for (int width = 1; width < runs; width *= 2) {
+    int n = 0;
+    for (int r = 0; r < runs; r += 2 * width) {
+      int m = r + width < runs ? r + width : runs;
+      int h = r + 2 * width < runs ? r + 2 * width : runs;
+      jobs[n] = (sort_job_t){.X = X,
+                             .src = src,
+                             .dst = dst,
+                             .lo = bounds[r],
+                             .mid = bounds[m],
+                             .hi = bounds[h]};
+      tp_add_work(tpool, merge_runs, &jobs[n]);
+      n++;
+    }
+    tp_wait(tpool);
+    int *t = src;
+    src = dst;
+    dst = t;
+  }
+
+  free(bounds);
+  free(jobs);
+  return src;
+}
+
+// Una scrittura sequenziale in una posizione fissa del file
+typedef struct {
+  int fd;
+  const char *buf;
+  size_t len;
+  off_t off;
+  int err;
+} write_job_t;
+
+static void write_chunk(void *arg) {
+  write_job_t *j = (write_job_t *)arg;
+  size_t done = 0;
+  while (done < j->len) {
+    ssize_t w = pwrite(j->fd, j->buf + done, j->len - done, j->off + done);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      j->err = errno;
+      return;
+    }
+    done += w;
+  }
+}
+
+// Divide [buf, buf + len) in scritture da RANK_DUMP_CHUNK a partire da off
+static int add_writes(write_job_t *jobs, int n, int fd, const void *buf,
+                      size_t len, off_t off) {
+  for (size_t pos = 0; pos < len; pos += RANK_DUMP_CHUNK) {
+    size_t part = len - pos < RANK_DUMP_CHUNK ? len - pos : RANK_DUMP_CHUNK;
+    jobs[n++] = (write_job_t){
+        .fd = fd, .buf = (const char *)buf + pos, .len = part, .off = off + pos};
+  }
+  return n;
+}
+
+int rank_dump_write(const char *path, const double *X, int N, bool with_order,
+                    thread_pool_t *tpool) {
+  if (path == NULL || X == NULL || N < 0 || tpool == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  rank_dump_header_t h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, RANK_DUMP_MAGIC, 4);
+  h.version = RANK_DUMP_VERSION;
+  h.N = N;
+  h.ranks_offset = align8(sizeof(rank_dump_header_t));
+  uint64_t size = h.ranks_offset + (uint64_t)N * sizeof(double);
+
+  // L'ordinamento procede prima delle scritture, così tutte le scritture
+  // partono insieme
+  int *order = NULL;
+  int *tmp = NULL;
+  int *sorted = NULL;
+  if (with_order) {
+    h.flags |= RANK_DUMP_HAS_ORDER;
+    h.order_offset = align8(size);
+    size = h.order_offset + (uint64_t)N * sizeof(int32_t);
+
+    order = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+    tmp = (int *)malloc((N > 0 ? N : 1) * sizeof(int));
+    if (order == NULL || tmp == NULL ||
+        (sorted = sort_order(X, N, order, tmp, tpool)) == NULL) {
+      free(order);
+      free(tmp);
+      errno = ENOMEM;
+      return -1;
+    }
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    free(order);
+    free(tmp);
+    return -1;
+  }
+
+  // La dimensione finale subito: i thread scrivono in posizioni diverse
+  // senza estendere il file uno dopo l'altro
+  size_t data = (size_t)N * sizeof(double) + (with_order ? N * sizeof(int) : 0);
+  int jobs_num = 1 + 2 + (int)(data / RANK_DUMP_CHUNK);
+  write_job_t *jobs = (write_job_t *)calloc(jobs_num, sizeof(write_job_t));
+  if (jobs == NULL || ftruncate(fd, (off_t)size) != 0) {
+    int saved = errno;
+    free(jobs);
+    close(fd);
+    free(order);
+    free(tmp);
+    errno = saved;
+    return -1;
+  }
+
+  int n = add_writes(jobs, 0, fd, &h, sizeof(h), 0);
+  n = add_writes(jobs, n, fd, X, (size_t)N * sizeof(double), h.ranks_offset);
+  if (with_order)
+    n = add_writes(jobs, n, fd, sorted, (size_t)N * sizeof(int),
+                   h.order_offset);
+  for (int i = 0; i < n; i++)
+    tp_add_work(tpool, write_chunk, &jobs[i]);
+  tp_wait(tpool);
+
+  int err = 0;
+  for (int i = 0; i < n && err == 0; i++)
+    err = jobs[i].err;
+  if (close(fd) != 0 && err == 0)
+    err = errno;
+
+  free(jobs);
+  free(order);
+  free(tmp);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
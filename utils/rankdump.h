@@ -0,0 +1,39 @@
+#ifndef RANKDUMP_H
+#define RANKDUMP_H
+
+#include "threadpool.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Vettore completo dei rank in un file binario da mappare con mmap per
+// accessi casuali. Tutti i campi sono nell'ordine dei byte della macchina
+// (little-endian su x86-64 e arm64):
+//
+//   offset 0             intestazione rank_dump_header_t (32 byte)
+//   ranks_offset         double ranks[N], rank del nodo i (id 0-based)
+//   order_offset         int32 order[N], solo con RANK_DUMP_HAS_ORDER: id
+//                        dei nodi per rank decrescente, a parità di rank
+//                        prima l'id minore (lo stesso ordine del top K)
+//
+// Gli offset sono multipli di 8, quindi gli array sono allineati
+
+#define RANK_DUMP_MAGIC "PRRK"
+#define RANK_DUMP_VERSION 1
+#define RANK_DUMP_HAS_ORDER 1u
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t flags;
+  int32_t N;
+  uint64_t ranks_offset;
+  uint64_t order_offset; // 0 senza RANK_DUMP_HAS_ORDER
+} rank_dump_header_t;
+
+// Scrive X[0..N-1] (e l'ordine, se with_order) in path con scritture
+// parallele sul thread pool; l'ordinamento usa lo stesso pool.
+// Ritorna 0 o -1 con errno impostato
+int rank_dump_write(const char *path, const double *X, int N, bool with_order,
+                    thread_pool_t *tpool);
+
+#endif // RANKDUMP_H
@@ -0,0 +1,24 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+// Stato incrementale: i dati possono arrivare a pezzi di qualsiasi lunghezza
+typedef struct {
+  uint32_t state[8];
+  uint64_t length; // Byte elaborati finora
+  unsigned char block[64];
+  size_t block_len;
+} sha256_t;
+
+void sha256_init(sha256_t *ctx);
+void sha256_update(sha256_t *ctx, const void *data, size_t len);
+void sha256_final(sha256_t *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+// Scrive il digest in esadecimale (65 byte con il terminatore)
+void sha256_hex(const unsigned char digest[SHA256_DIGEST_SIZE], char *hex);
+
+#endif // SHA256_H
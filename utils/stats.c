@@ -0,0 +1,126 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static const char *phase_names[PHASE_COUNT] = {
+    "read_size", "alloc", "parse", "build", "pagerank", "sort", "output"};
+
+double stats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+long stats_peak_rss_kb(void) {
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return -1;
+  return ru.ru_maxrss; // Su Linux è già in KB
+}
+
+void stats_init(stats_t *s, bool enabled) {
+  memset(s, 0, sizeof(stats_t));
+  s->enabled = enabled;
+  s->start = stats_now();
+}
+
+void stats_destroy(stats_t *s) {
+  free(s->iters);
+  s->iters = NULL;
+  s->iters_num = 0;
+  s->iters_cap = 0;
+}
+
+void stats_begin(stats_t *s, stats_phase_t phase) {
+  if (s == NULL || !s->enabled)
+    return;
+  s->phase_start[phase] = stats_now();
+}
+
+void stats_end(stats_t *s, stats_phase_t phase) {
+  if (s == NULL || !s->enabled)
+    return;
+  s->phase_time[phase] += stats_now() - s->phase_start[phase];
+}
+
+void stats_add_iter(stats_t *s, iter_stats_t it) {
+  if (s == NULL || !s->enabled)
+    return;
+
+  if (s->iters_num == s->iters_cap) {
+    int cap = s->iters_cap ? s->iters_cap * 2 : 64;
+    iter_stats_t *iters =
+        (iter_stats_t *)realloc(s->iters, cap * sizeof(iter_stats_t));
+    if (iters == NULL) {
+      perror("Errore allocazione statistiche iterazioni.");
+      return;
+    }
+    s->iters = iters;
+    s->iters_cap = cap;
+  }
+
+  s->iters[s->iters_num++] = it;
+}
+
+// Evita divisioni per zero nei rapporti
+static double rate(double num, double den) {
+  if (den <= 0)
+    return 0;
+  return num / den;
+}
+
+void stats_print_json(stats_t *s, FILE *f) {
+  double load = s->phase_time[PHASE_PARSE] + s->phase_time[PHASE_BUILD];
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"nodes\": %d,\n", s->nodes);
+  fprintf(f, "  \"dead_end_nodes\": %d,\n", s->dead_end);
+  fprintf(f, "  \"edges_read\": %ld,\n", s->edges_read);
+  fprintf(f, "  \"valid_arcs\": %ld,\n", s->valid_edges);
+  fprintf(f, "  \"threads\": %d,\n", s->threads);
+  fprintf(f, "  \"method\": \"%s\",\n", s->monte_carlo ? "mc" : "power");
+  fprintf(f, "  \"iterations\": %d,\n", s->iters_num);
+  fprintf(f, "  \"converged\": %s,\n", s->converged ? "true" : "false");
+  fprintf(f, "  \"stable_stop\": %s,\n", s->stable_stop ? "true" : "false");
+  fprintf(f, "  \"stop_reason\": \"%s\",\n",
+          s->monte_carlo   ? "walks"
+          : s->stable_stop ? "stable_top_k"
+          : s->converged   ? "converged"
+                           : "max_iterations");
+  fprintf(f, "  \"iterations_saved_estimate\": %d,\n", s->iters_saved);
+
+  fprintf(f, "  \"phases\": {\n");
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    fprintf(f, "    \"%s\": %.9f,\n", phase_names[i], s->phase_time[i]);
+  }
+  fprintf(f, "    \"total\": %.9f\n", stats_now() - s->start);
+  fprintf(f, "  },\n");
+
+  fprintf(f, "  \"load_edges_per_sec\": %.1f,\n", rate(s->edges_read, load));
+  fprintf(f, "  \"peak_rss_kb\": %ld,\n", stats_peak_rss_kb());
+
+  fprintf(f, "  \"thread_pool\": {\n");
+  fprintf(f, "    \"threads\": %d,\n", s->tp.threads);
+  fprintf(f, "    \"jobs\": %ld,\n", s->tp.jobs);
+  fprintf(f, "    \"queue_wait_total\": %.9f,\n", s->tp.queue_wait);
+  fprintf(f, "    \"queue_wait_avg\": %.9f,\n",
+          rate(s->tp.queue_wait, s->tp.jobs));
+  fprintf(f, "    \"idle_total\": %.9f,\n", s->tp.idle);
+  fprintf(f, "    \"busy_total\": %.9f\n", s->tp.busy);
+  fprintf(f, "  },\n");
+
+  fprintf(f, "  \"per_iteration\": [");
+  for (int i = 0; i < s->iters_num; i++) {
+    iter_stats_t *it = &s->iters[i];
+    fprintf(f,
+            "%s\n    {\"iter\": %d, \"time\": %.9f, \"x_update\": %.9f, "
+            "\"reduce\": %.9f, \"error\": %.12e, \"edges_per_sec\": %.1f}",
+            i ? "," : "", i + 1, it->time, it->x_update, it->reduce, it->error,
+            rate(s->valid_edges, it->time));
+  }
+  fprintf(f, "%s]\n", s->iters_num ? "\n  " : "");
+  fprintf(f, "}\n");
+}
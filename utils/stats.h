@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Fasi misurate con cronometro monotono
+typedef enum {
+  PHASE_READ_SIZE, // read_size_from_file
+  PHASE_ALLOC,     // create_inmap / create_outgoing_edges
+  PHASE_PARSE,     // read_from_grafo (produttore)
+  PHASE_BUILD,     // attesa dei consumer dopo la fine del parsing
+  PHASE_PAGERANK,  // chiamata a pagerank()
+  PHASE_SORT,      // qsort dei risultati
+  PHASE_OUTPUT,    // conteggi finali e stampa
+  PHASE_COUNT
+} stats_phase_t;
+
+// Tempi di una singola iterazione di pagerank()
+typedef struct {
+  double time;     // durata totale dell'iterazione
+  double x_update; // calcolo di X(t+1) su tutti i nodi
+  double reduce;   // calcolo di S, Y ed errore
+  double error;    // errore L1 a fine iterazione
+} iter_stats_t;
+
+// Contatori del thread pool (secondi cumulati su tutti i thread)
+typedef struct {
+  int threads;
+  long jobs;
+  double queue_wait; // tempo tra tp_add_work e l'inizio del lavoro
+  double idle;       // tempo passato dai worker in attesa di lavoro
+  double busy;       // tempo passato dai worker ad eseguire lavori
+} tp_stats_t;
+
+typedef struct stats {
+  bool enabled;
+  double start;
+  double phase_start[PHASE_COUNT];
+  double phase_time[PHASE_COUNT];
+
+  iter_stats_t *iters;
+  int iters_num;
+  int iters_cap;
+
+  int nodes;
+  int dead_end;
+  int threads;
+  long edges_read;
+  long valid_edges;
+  bool converged;
+  bool stable_stop; // Fermato dall'arresto sulla classifica dei primi K
+  bool monte_carlo; // Stima a cammini (--mc): niente iterazioni né convergenza
+  int iters_saved;  // Stima delle iterazioni evitate, al più fino a maxiter
+
+  tp_stats_t tp;
+} stats_t;
+
+// Tempo monotono in secondi
+double stats_now(void);
+
+// Picco di memoria residente del processo in KB
+long stats_peak_rss_kb(void);
+
+void stats_init(stats_t *s, bool enabled);
+void stats_destroy(stats_t *s);
+
+// Cronometri per fase, non fanno nulla se le statistiche sono disattivate
+void stats_begin(stats_t *s, stats_phase_t phase);
+void stats_end(stats_t *s, stats_phase_t phase);
+
+void stats_add_iter(stats_t *s, iter_stats_t it);
+
+// Stampa il report in formato JSON
+void stats_print_json(stats_t *s, FILE *f);
+
+#endif // STATS_H
@@ -78,6 +78,10 @@ bool tp_add_work(thread_pool_t *tpool, thread_func_t func, void *arg) {
 
   bool res = enqueue(tpool->work_queue, func, arg);
 
+  if (res && tpool->stats_enabled) {
+    tpool->work_queue->tail->enqueued = stats_now();
+  }
+
   if (res) {
     pthread_cond_broadcast(&(tpool->work_cond));
   }
@@ -114,13 +118,23 @@ void *tp_worker(void *arg) {
   thread_pool_t *tpool = arg;
   thread_pool_work_t *work;
 
+  pthread_mutex_lock(&(tpool->work_mutex));
+  int id = tpool->next_id++;
+  pthread_mutex_unlock(&(tpool->work_mutex));
+
   while (1) {
     pthread_mutex_lock(&(tpool->work_mutex));
 
+    double idle_start = tpool->stats_enabled ? stats_now() : 0;
+
     while (is_empty(tpool->work_queue) && !tpool->stop) {
       pthread_cond_wait(&(tpool->work_cond), &(tpool->work_mutex));
     }
 
+    if (tpool->stats_enabled && idle_start) {
+      tpool->stats.idle += stats_now() - idle_start;
+    }
+
     if (tpool->stop) {
       break;
     }
@@ -128,17 +142,37 @@ void *tp_worker(void *arg) {
     work = dequeue(tpool->work_queue);
     tpool->working_counter++;
 
+    double busy_start = 0;
+    if (tpool->stats_enabled && work != NULL && work->enqueued) {
+      busy_start = stats_now();
+      tpool->stats.queue_wait += busy_start - work->enqueued;
+      tpool->stats.jobs++;
+    }
+
+    metrics_page_t *metrics = tpool->metrics;
+
     pthread_mutex_unlock(&(tpool->work_mutex));
 
+    // Il tempo per worker va nella pagina senza passare dal mutex
+    double run_start = metrics != NULL ? stats_now() : 0;
     if (work != NULL) {
       // printf("Partito Lavoro Nodo\n");
       work->func(work->arg);
       tp_work_destroy(work);
     }
+    if (metrics != NULL)
+      metrics_add_busy(metrics, id,
+                       (uint64_t)((stats_now() - run_start) * 1e9));
+
+    double busy_end = busy_start ? stats_now() : 0;
 
     pthread_mutex_lock(&(tpool->work_mutex));
     tpool->working_counter--;
 
+    if (busy_start) {
+      tpool->stats.busy += busy_end - busy_start;
+    }
+
     bool cond = !tpool->stop && tpool->working_counter == 0 &&
                 is_empty(tpool->work_queue);
 
@@ -171,16 +205,18 @@ thread_pool_t *tp_create(int thread_num) {
 
   queue_init(tpool->work_queue);
   tpool->thread_counter = thread_num;
+  tpool->thread_num = thread_num;
+  tpool->stats.threads = thread_num;
   pthread_mutex_init(&(tpool->work_mutex), NULL);
   pthread_cond_init(&(tpool->work_cond), NULL);
   pthread_cond_init(&(tpool->working_cond), NULL);
 
+  // I worker restano joinable: tp_destroy li attende prima di distruggere
+  // il mutex che usano fino all'ultima istruzione
   for (int i = 0; i < thread_num; i++) {
     pthread_create(&threads[i], NULL, tp_worker, tpool);
-    pthread_detach(threads[i]);
   }
-
-  free(threads);
+  tpool->threads = threads;
 
   return tpool;
 }
@@ -203,6 +239,11 @@ void tp_destroy(thread_pool_t *tpool) {
 
   tp_wait(tpool);
 
+  for (int i = 0; i < tpool->thread_num; i++) {
+    pthread_join(tpool->threads[i], NULL);
+  }
+  free(tpool->threads);
+
   pthread_mutex_destroy(&(tpool->work_mutex));
   pthread_cond_destroy(&(tpool->work_cond));
   pthread_cond_destroy(&(tpool->working_cond));
@@ -211,3 +252,33 @@ void tp_destroy(thread_pool_t *tpool) {
 
   free(tpool);
 }
+
+void tp_enable_stats(thread_pool_t *tpool) {
+  if (tpool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&(tpool->work_mutex));
+  tpool->stats_enabled = true;
+  pthread_mutex_unlock(&(tpool->work_mutex));
+}
+
+void tp_set_metrics(thread_pool_t *tpool, metrics_page_t *metrics) {
+  if (tpool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&(tpool->work_mutex));
+  tpool->metrics = metrics;
+  pthread_mutex_unlock(&(tpool->work_mutex));
+}
+
+void tp_get_stats(thread_pool_t *tpool, tp_stats_t *out) {
+  if (tpool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&(tpool->work_mutex));
+  *out = tpool->stats;
+  pthread_mutex_unlock(&(tpool->work_mutex));
+}
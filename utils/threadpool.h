@@ -5,11 +5,15 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "metrics.h"
+#include "stats.h"
+
 typedef void (*thread_func_t)(void *arg);
 
 typedef struct thread_pool_work {
   thread_func_t func;
   void *arg;
+  double enqueued; // Istante di inserimento in coda (solo con statistiche)
   struct thread_pool_work *next;
 } thread_pool_work_t;
 
@@ -27,8 +31,16 @@ typedef struct thread_pool {
 
   int working_counter; // Quanti threads stanno lavorando
   int thread_counter;
+  int thread_num; // Thread creati, attesi da tp_destroy
+  int next_id;    // Indice del prossimo worker che parte
   bool stop;
   pthread_t *threads;
+
+  bool stats_enabled; // Se attivo i worker misurano attese e lavoro
+  tp_stats_t stats;   // Protetto da work_mutex
+
+  // Se non NULL ogni worker somma qui il proprio tempo di lavoro
+  metrics_page_t *metrics;
 } thread_pool_t;
 
 // Prototipi delle funzioni per la gestione del thread pool
@@ -39,4 +51,11 @@ void *tp_worker(void *arg);
 thread_pool_t *tp_create(int thread_num);
 void tp_destroy(thread_pool_t *tpool);
 
+// Statistiche su coda e tempi dei worker
+void tp_enable_stats(thread_pool_t *tpool);
+void tp_get_stats(thread_pool_t *tpool, tp_stats_t *out);
+
+// Tempo di lavoro per worker nella pagina delle metriche (NULL per smettere)
+void tp_set_metrics(thread_pool_t *tpool, metrics_page_t *metrics);
+
 #endif // !THREADPOOL_1_H
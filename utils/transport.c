@@ -0,0 +1,386 @@
+#include "transport.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// TRASPORTO "shm": un ring di byte per ogni coppia ordinata di processi in
+// una mappatura anonima condivisa, creata prima delle fork. Ogni processo ha
+// un semaforo "campanello" su cui dorme quando non può avanzare; chi scrive
+// o libera spazio in un ring suona il campanello dell'altro capo.
+
+#define SHM_CHANNEL_SIZE (64 * 1024)
+
+typedef struct {
+  _Alignas(64) _Atomic uint64_t head; // Byte scritti
+  _Alignas(64) _Atomic uint64_t tail; // Byte letti
+  char data[SHM_CHANNEL_SIZE];
+} shm_channel_t;
+
+typedef struct {
+  sem_t *doorbell;       // Uno per processo
+  shm_channel_t *chan;   // chan[from * size + to]
+  size_t map_size;
+  void *map;
+} shm_impl_t;
+
+static transport_t *shm_create(int size);
+static void shm_attach(transport_t *t, int rank);
+static int shm_sendrecv(transport_t *t, int to, const void *sbuf, size_t slen,
+                        int from, void *rbuf, size_t rlen);
+static void shm_destroy(transport_t *t);
+
+static const transport_ops_t shm_ops = {.name = "shm",
+                                        .create = shm_create,
+                                        .attach = shm_attach,
+                                        .sendrecv = shm_sendrecv,
+                                        .destroy = shm_destroy};
+
+static transport_t *shm_create(int size) {
+  size_t bells = ((size * sizeof(sem_t)) + 63) / 64 * 64;
+  size_t map_size = bells + (size_t)size * size * sizeof(shm_channel_t);
+  void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  shm_impl_t *impl = (shm_impl_t *)calloc(1, sizeof(shm_impl_t));
+  transport_t *t = (transport_t *)calloc(1, sizeof(transport_t));
+  if (impl == NULL || t == NULL) {
+    free(impl);
+    free(t);
+    munmap(map, map_size);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  impl->map = map;
+  impl->map_size = map_size;
+  impl->doorbell = (sem_t *)map;
+  impl->chan = (shm_channel_t *)((char *)map + bells);
+  for (int i = 0; i < size; i++)
+    sem_init(&impl->doorbell[i], 1, 0);
+
+  t->ops = &shm_ops;
+  t->rank = -1;
+  t->size = size;
+  t->impl = impl;
+  return t;
+}
+
+static void shm_attach(transport_t *t, int rank) { t->rank = rank; }
+
+// Copia fino a len byte nel ring, ritorna quanti ne ha scritti
+static size_t ring_write(shm_channel_t *ch, const char *src, size_t len) {
+  uint64_t head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&ch->tail, memory_order_acquire);
+  size_t n = SHM_CHANNEL_SIZE - (size_t)(head - tail);
+  if (n > len)
+    n = len;
+
+  size_t pos = head % SHM_CHANNEL_SIZE;
+  size_t first = n < SHM_CHANNEL_SIZE - pos ? n : SHM_CHANNEL_SIZE - pos;
+  memcpy(ch->data + pos, src, first);
+  memcpy(ch->data, src + first, n - first);
+
+  atomic_store_explicit(&ch->head, head + n, memory_order_release);
+  return n;
+}
+
+static size_t ring_read(shm_channel_t *ch, char *dst, size_t len) {
+  uint64_t tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit(&ch->head, memory_order_acquire);
+  size_t n = (size_t)(head - tail);
+  if (n > len)
+    n = len;
+
+  size_t pos = tail % SHM_CHANNEL_SIZE;
+  size_t first = n < SHM_CHANNEL_SIZE - pos ? n : SHM_CHANNEL_SIZE - pos;
+  memcpy(dst, ch->data + pos, first);
+  memcpy(dst + first, ch->data, n - first);
+
+  atomic_store_explicit(&ch->tail, tail + n, memory_order_release);
+  return n;
+}
+
+// Un passo di avanzamento su invio e ricezione, vero se ha spostato byte
+static bool shm_progress(transport_t *t, int to, const char *sbuf,
+                         size_t slen, size_t *sent, int from, char *rbuf,
+                         size_t rlen, size_t *recvd) {
+  shm_impl_t *impl = (shm_impl_t *)t->impl;
+  bool progress = false;
+
+  if (*sent < slen) {
+    size_t n = ring_write(&impl->chan[t->rank * t->size + to], sbuf + *sent,
+                          slen - *sent);
+    if (n > 0) {
+      *sent += n;
+      progress = true;
+      sem_post(&impl->doorbell[to]);
+    }
+  }
+
+  if (*recvd < rlen) {
+    size_t n = ring_read(&impl->chan[from * t->size + t->rank], rbuf + *recvd,
+                         rlen - *recvd);
+    if (n > 0) {
+      *recvd += n;
+      progress = true;
+      sem_post(&impl->doorbell[from]); // Spazio libero per il mittente
+    }
+  }
+
+  return progress;
+}
+
+static int shm_sendrecv(transport_t *t, int to, const void *sbuf, size_t slen,
+                        int from, void *rbuf, size_t rlen) {
+  shm_impl_t *impl = (shm_impl_t *)t->impl;
+  sem_t *bell = &impl->doorbell[t->rank];
+  size_t sent = to < 0 ? slen : 0;
+  size_t recvd = from < 0 ? rlen : 0;
+
+  while (sent < slen || recvd < rlen) {
+    if (shm_progress(t, to, (const char *)sbuf, slen, &sent, from,
+                     (char *)rbuf, rlen, &recvd))
+      continue;
+
+    // Svuota i segnali vecchi e ricontrolla prima di dormire: un segnale
+    // arrivato dopo il controllo resta nel semaforo e sveglia la sem_wait
+    while (sem_trywait(bell) == 0)
+      ;
+    if (shm_progress(t, to, (const char *)sbuf, slen, &sent, from,
+                     (char *)rbuf, rlen, &recvd))
+      continue;
+    while (sem_wait(bell) != 0) {
+      if (errno != EINTR)
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+static void shm_destroy(transport_t *t) {
+  shm_impl_t *impl = (shm_impl_t *)t->impl;
+  // I semafori vengono distrutti dall'ultimo che li usa: il padre, che
+  // chiama destroy solo dopo aver atteso tutti i figli
+  if (t->rank < 0) {
+    for (int i = 0; i < t->size; i++)
+      sem_destroy(&impl->doorbell[i]);
+  }
+  munmap(impl->map, impl->map_size);
+  free(impl);
+  free(t);
+}
+
+// TRASPORTO "unix": una socketpair per ogni coppia di processi, creata prima
+// delle fork. Dopo attach ogni figlio tiene solo i propri capi.
+
+typedef struct {
+  int *fds; // fds[rank * size + peer], -1 se chiuso
+} unix_impl_t;
+
+static transport_t *unix_create(int size);
+static void unix_attach(transport_t *t, int rank);
+static int unix_sendrecv(transport_t *t, int to, const void *sbuf,
+                         size_t slen, int from, void *rbuf, size_t rlen);
+static void unix_destroy(transport_t *t);
+
+static const transport_ops_t unix_ops = {.name = "unix",
+                                         .create = unix_create,
+                                         .attach = unix_attach,
+                                         .sendrecv = unix_sendrecv,
+                                         .destroy = unix_destroy};
+
+static transport_t *unix_create(int size) {
+  unix_impl_t *impl = (unix_impl_t *)calloc(1, sizeof(unix_impl_t));
+  transport_t *t = (transport_t *)calloc(1, sizeof(transport_t));
+  int *fds = (int *)malloc((size_t)size * size * sizeof(int));
+  if (impl == NULL || t == NULL || fds == NULL) {
+    free(impl);
+    free(t);
+    free(fds);
+    errno = ENOMEM;
+    return NULL;
+  }
+  for (int i = 0; i < size * size; i++)
+    fds[i] = -1;
+
+  impl->fds = fds;
+  t->ops = &unix_ops;
+  t->rank = -1;
+  t->size = size;
+  t->impl = impl;
+
+  for (int i = 0; i < size; i++) {
+    for (int j = i + 1; j < size; j++) {
+      int sv[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        int saved = errno;
+        unix_destroy(t);
+        errno = saved;
+        return NULL;
+      }
+      fds[i * size + j] = sv[0];
+      fds[j * size + i] = sv[1];
+    }
+  }
+
+  return t;
+}
+
+static void unix_attach(transport_t *t, int rank) {
+  unix_impl_t *impl = (unix_impl_t *)t->impl;
+  t->rank = rank;
+
+  for (int i = 0; i < t->size; i++) {
+    for (int j = 0; j < t->size; j++) {
+      int *fd = &impl->fds[i * t->size + j];
+      if (*fd < 0)
+        continue;
+      if (i != rank) {
+        close(*fd);
+        *fd = -1;
+      } else {
+        fcntl(*fd, F_SETFL, fcntl(*fd, F_GETFL) | O_NONBLOCK);
+      }
+    }
+  }
+}
+
+static int unix_sendrecv(transport_t *t, int to, const void *sbuf,
+                         size_t slen, int from, void *rbuf, size_t rlen) {
+  unix_impl_t *impl = (unix_impl_t *)t->impl;
+  int sfd = to < 0 ? -1 : impl->fds[t->rank * t->size + to];
+  int rfd = from < 0 ? -1 : impl->fds[t->rank * t->size + from];
+  size_t sent = to < 0 ? slen : 0;
+  size_t recvd = from < 0 ? rlen : 0;
+
+  while (sent < slen || recvd < rlen) {
+    struct pollfd pfd[2];
+    int n = 0;
+    if (sent < slen)
+      pfd[n++] = (struct pollfd){.fd = sfd, .events = POLLOUT};
+    if (recvd < rlen) {
+      if (n == 1 && sfd == rfd)
+        pfd[0].events |= POLLIN;
+      else
+        pfd[n++] = (struct pollfd){.fd = rfd, .events = POLLIN};
+    }
+
+    if (poll(pfd, n, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+      if ((pfd[i].revents & (POLLOUT | POLLERR)) && sent < slen &&
+          pfd[i].fd == sfd) {
+        ssize_t w = send(sfd, (const char *)sbuf + sent, slen - sent,
+                         MSG_NOSIGNAL);
+        if (w < 0 && errno != EAGAIN && errno != EINTR)
+          return -1;
+        if (w > 0)
+          sent += w;
+      }
+      if ((pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) && recvd < rlen &&
+          pfd[i].fd == rfd) {
+        ssize_t r = recv(rfd, (char *)rbuf + recvd, rlen - recvd, 0);
+        if (r == 0) {
+          errno = ECONNRESET; // Il processo dall'altra parte è terminato
+          return -1;
+        }
+        if (r < 0 && errno != EAGAIN && errno != EINTR)
+          return -1;
+        if (r > 0)
+          recvd += r;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void unix_destroy(transport_t *t) {
+  unix_impl_t *impl = (unix_impl_t *)t->impl;
+  for (int i = 0; i < t->size * t->size; i++) {
+    if (impl->fds[i] >= 0)
+      close(impl->fds[i]);
+  }
+  free(impl->fds);
+  free(impl);
+  free(t);
+}
+
+// API
+
+static const transport_ops_t *transports[] = {&shm_ops, &unix_ops};
+
+transport_t *transport_create(const char *kind, int size) {
+  for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+    if (strcmp(transports[i]->name, kind) == 0)
+      return transports[i]->create(size);
+  }
+  errno = EINVAL;
+  return NULL;
+}
+
+void transport_attach(transport_t *t, int rank) { t->ops->attach(t, rank); }
+
+void transport_destroy(transport_t *t) {
+  if (t != NULL)
+    t->ops->destroy(t);
+}
+
+int transport_sendrecv(transport_t *t, int to, const void *sbuf, size_t slen,
+                       int from, void *rbuf, size_t rlen) {
+  return t->ops->sendrecv(t, to, sbuf, slen, from, rbuf, rlen);
+}
+
+int transport_send(transport_t *t, int to, const void *buf, size_t len) {
+  return t->ops->sendrecv(t, to, buf, len, -1, NULL, 0);
+}
+
+int transport_recv(transport_t *t, int from, void *buf, size_t len) {
+  return t->ops->sendrecv(t, -1, NULL, 0, from, buf, len);
+}
+
+int transport_allreduce_sum(transport_t *t, double *vals, int n) {
+  size_t len = (size_t)n * sizeof(double);
+
+  if (t->rank != 0) {
+    if (transport_send(t, 0, vals, len) != 0)
+      return -1;
+    return transport_recv(t, 0, vals, len);
+  }
+
+  double *tmp = (double *)malloc(len);
+  if (tmp == NULL)
+    return -1;
+
+  for (int q = 1; q < t->size; q++) {
+    if (transport_recv(t, q, tmp, len) != 0) {
+      free(tmp);
+      return -1;
+    }
+    for (int i = 0; i < n; i++)
+      vals[i] += tmp[i];
+  }
+  free(tmp);
+
+  for (int q = 1; q < t->size; q++) {
+    if (transport_send(t, q, vals, len) != 0)
+      return -1;
+  }
+  return 0;
+}
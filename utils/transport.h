@@ -0,0 +1,51 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+
+// Canale di comunicazione tra i processi del calcolo partizionato. Il
+// trasporto viene creato dal processo padre prima delle fork, ogni figlio lo
+// collega al proprio rank con transport_attach. Le implementazioni fornite
+// sono "shm" (ring in memoria condivisa) e "unix" (socketpair tra ogni
+// coppia di processi); per aggiungerne una basta un nuovo transport_ops_t.
+
+typedef struct transport transport_t;
+
+typedef struct {
+  const char *name;
+  transport_t *(*create)(int size);
+  // Chiamata nel figlio dopo la fork: lascia solo le risorse del rank.
+  // Il padre la chiama con rank -1 per rilasciare quelle dei figli
+  void (*attach)(transport_t *t, int rank);
+  // Invia slen byte a to e riceve rlen byte da from procedendo su entrambi
+  // insieme, così due processi che si scambiano messaggi più grandi del
+  // canale non si bloccano a vicenda. to e from possono essere -1.
+  // Ritorna 0 o -1 con errno impostato
+  int (*sendrecv)(transport_t *t, int to, const void *sbuf, size_t slen,
+                  int from, void *rbuf, size_t rlen);
+  void (*destroy)(transport_t *t);
+} transport_ops_t;
+
+struct transport {
+  const transport_ops_t *ops;
+  int rank; // -1 nel processo padre
+  int size;
+  void *impl;
+};
+
+// Crea il trasporto kind ("shm" o "unix") per size processi. Ritorna NULL
+// con errno = EINVAL se kind non esiste
+transport_t *transport_create(const char *kind, int size);
+void transport_attach(transport_t *t, int rank);
+void transport_destroy(transport_t *t);
+
+int transport_sendrecv(transport_t *t, int to, const void *sbuf, size_t slen,
+                       int from, void *rbuf, size_t rlen);
+int transport_send(transport_t *t, int to, const void *buf, size_t len);
+int transport_recv(transport_t *t, int from, void *buf, size_t len);
+
+// Somma vals[0..n-1] su tutti i processi, il risultato arriva a tutti. Il
+// rank 0 somma nell'ordine dei rank, quindi il risultato è deterministico
+int transport_allreduce_sum(transport_t *t, double *vals, int n);
+
+#endif // TRANSPORT_H